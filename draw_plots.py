@@ -1,7 +1,8 @@
-from sys import argv
+from sys import argv, exit
 from itertools import accumulate
 from pathlib import Path
 from json import load, JSONDecodeError
+from re import match
 
 import numpy as np
 
@@ -10,7 +11,121 @@ from matplotlib import pyplot as plt
 Path("out_plots").mkdir(exist_ok=True)
 plt.style.use("ggplot")
 
+
+# Comparison mode:
+#   python draw_plots.py --compare <base dir> <new dir> [tolerance]
+# Both directories hold JSON files written with BENCH_REPETITIONS set. For
+# every benchmark present in both, prints the speedup base time / new time,
+# above 1 when new is faster, with a bootstrap 95% confidence interval. Exits
+# with 1 if any benchmark is slower by more than `tolerance` (default 0.05)
+# with its whole interval below 1.
+def load_repetitions(directory):
+    runs = {}
+    for path in sorted(Path(directory).glob("*.json")):
+        with open(path) as f:
+            try:
+                data = load(f)
+            except JSONDecodeError:
+                continue
+        for d in data["benchmarks"]:
+            if d.get("run_type") == "aggregate":
+                continue
+            # Multithreaded benchmarks (UseRealTime) are timed by the wall
+            # clock, their cpu_time only covers the calling thread. Entries
+            # without timings, e.g. from profile_dump(), are skipped
+            field = "real_time" if "/real_time" in d["name"] else "cpu_time"
+            if field not in d:
+                continue
+            runs.setdefault((path.stem, d["name"]), []).append(d[field])
+    return {k: np.array(v) for k, v in runs.items()}
+
+
+def speedup_ci(base, new, n_resamples=10000, seed=0):
+    speedup = base.mean() / new.mean()
+    if len(base) < 2 or len(new) < 2:
+        return speedup, np.nan, np.nan
+    rng = np.random.default_rng(seed)
+    b = rng.choice(base, (n_resamples, len(base))).mean(axis=1)
+    n = rng.choice(new, (n_resamples, len(new))).mean(axis=1)
+    lo, hi = np.percentile(b / n, [2.5, 97.5])
+    return speedup, lo, hi
+
+
+def compare(base_dir, new_dir, tolerance):
+    base = load_repetitions(base_dir)
+    new = load_repetitions(new_dir)
+    common = sorted(set(base) & set(new))
+    if not common:
+        print(f"no benchmarks in common between {base_dir} and {new_dir}")
+        return 2
+
+    regressions = 0
+    plots = {}
+    for key in common:
+        speedup, lo, hi = speedup_ci(base[key], new[key])
+        regressed = hi < 1 and speedup < 1 - tolerance
+        regressions += regressed
+        ci = "" if np.isnan(lo) else f" [{lo:5.3f}, {hi:5.3f}]"
+        flag = "  REGRESSION" if regressed else ""
+        print(f"{key[0]}: {key[1]:<40} {speedup:6.3f}x{ci}{flag}")
+
+        # name ~ bm_method<type, rows, cols>
+        m = match(r"^(\w+)<(\w+), \(?(\d+)\)?, \(?(\d+)\)?>$", key[1])
+        if m is None:
+            continue
+        method, dtype, n_rows, n_cols = m.groups()
+        plot = plots.setdefault((dtype, int(n_cols), key[0]), {})
+        plot.setdefault(method, []).append(
+            (
+                int(n_rows),
+                base[key].mean(),
+                new[key].mean(),
+                speedup,
+                speedup - lo if not np.isnan(lo) else 0,
+                hi - speedup if not np.isnan(hi) else 0,
+            )
+        )
+
+    for (dtype, n_cols, stem), methods in plots.items():
+        fig, axes = plt.subplots(ncols=2, figsize=(10, 5))
+        abs_plot, rel_plot = axes
+        for method, points in methods.items():
+            n_rows, t_base, t_new, speedup, err_lo, err_hi = np.array(
+                sorted(points)
+            ).T
+            (line,) = abs_plot.plot(
+                n_rows, t_base, "--", label=f"{method} base"
+            )
+            abs_plot.plot(
+                n_rows, t_new, color=line.get_color(), label=f"{method} new"
+            )
+            rel_plot.errorbar(
+                n_rows, speedup, yerr=[err_lo, err_hi], label=method, capsize=2
+            )
+        rel_plot.axhline(1, color="black", linewidth=0.8)
+        abs_plot.legend()
+        abs_plot.set_ylim(ymin=0)
+        abs_plot.set_xlabel("n rows")
+        abs_plot.set_title("absolute time")
+        rel_plot.legend()
+        rel_plot.set_xlabel("n rows")
+        rel_plot.set_title("speedup (base / new), 95% CI")
+
+        fig.suptitle(f"{stem}: {base_dir} vs {new_dir}")
+        fig.savefig(f"out_plots/compare_{stem}.pdf")
+
+    print(f"{regressions} significant regression(s) out of {len(common)}")
+    return 1 if regressions else 0
+
+
+if len(argv) > 1 and argv[1] == "--compare":
+    tolerance = float(argv[4]) if len(argv) > 4 else 0.05
+    exit(compare(argv[2], argv[3], tolerance))
+
 results = {}
+latency = {}
+profile = {}
+kernels = {}
 for arg in argv[1:]:
     with open(arg) as f:
         try:
@@ -18,18 +133,66 @@ for arg in argv[1:]:
         except JSONDecodeError:
             continue
     data = data["benchmarks"]
+    # Results with Blaze/Eigen routed to matvec_simd are plotted separately
+    variant = "_hook" if Path(arg).stem.endswith("_hook") else ""
 
     for d in data:
+        # Means/medians/stddevs of repeated runs, see --compare
+        if d.get("run_type") == "aggregate":
+            continue
+
+        # name ~ prof_<type, rows, cols>, from profile_dump()
+        # rows = -1 for shapes above the largest instrumented row count
+        if d["name"].startswith("prof_"):
+            params = d["name"][6:-1].split(",")
+            dtype = params[0]
+            n_rows = int(params[1])
+            n_cols = int(params[2])
+
+            key = (dtype, n_cols)
+            profile.setdefault(key, []).append(
+                (n_rows, d["calls"], d["cycles_per_call"])
+            )
+            continue
+
+        # name ~ bm_lat_mode_method<type, rows, cols>/iterations:n
+        # mode = warm | cold
+        if d["name"].startswith("bm_lat_"):
+            m = match(
+                r"^bm_lat_(\w+?)_(\w+)<(\w+), \(?(\d+)\)?, \(?(\d+)\)?>$",
+                d["name"].split("/")[0],
+            )
+            if m is None:
+                continue
+            mode, method, dtype, n_rows, n_cols = m.groups()
+            n_rows = int(n_rows)
+            n_cols = int(n_cols)
+
+            key = (dtype, n_cols, mode)
+            latency.setdefault(key, {}).setdefault(method, []).append(
+                (n_rows, d["p10"], d["p50"], d["p90"], d["p99"], d["p99.9"])
+            )
+            continue
+
         # name ~ bm_method<type, rows, cols>
-        # method = blaze | eigen | simd_
+        # method = blaze | eigen | simd_ | hadd_ | trsp_
 
         method = d["name"][3:8]
+        if method in ("hadd_", "trsp_"):
+            params = d["name"][9:-1].split(",")
+            key = (params[0], int(params[2]))
+            kernels.setdefault(key, {}).setdefault(method, []).append(
+                (int(params[1]), d["cpu_time"])
+            )
+            continue
+        if method not in ("blaze", "eigen", "simd_"):
+            continue
         params = d["name"][9:-1].split(",")
         dtype = params[0]
         n_rows = int(params[1])
         n_cols = int(params[2])
 
-        key = (dtype, n_cols)
+        key = (dtype, n_cols, variant)
 
         results[key] = results.get(
             key, {"time_b": [[], []], "time_e": [[], []], "time_s": [[], []],},
@@ -52,7 +215,7 @@ for key in results:
         results[key][a] = np.array(results[key][a])
 
 for key in results:
-    dtype, n_cols = key
+    dtype, n_cols, variant = key
     res = results[key]
 
     res_e = res["time_e"]
@@ -77,7 +240,7 @@ for key in results:
     e = np.exp(np.log(res_e[1][n_skip:] / res_s[1][n_skip:]).mean())
     b = np.exp(np.log(res_b[1][n_skip:] / res_s[1][n_skip:]).mean())
 
-    print(f"[{dtype}][n×{n_cols}][{n_cols}] => n : geometric average:")
+    print(f"[{dtype}][n×{n_cols}][{n_cols}]{variant} => n : geometric average:")
     print(f"{e:<4.3} faster than eigen")
     print(f"{b:<4.3} faster than blaze")
 
@@ -102,5 +265,72 @@ for key in results:
     abs_plot.set_xlabel("n rows")
     abs_plot.set_title("absolute time")
 
-    fig.suptitle(f"[{dtype}][n×{n_cols}][{n_cols}] => n ")
-    fig.savefig(f"out_plots/{dtype}_{n_cols}_cols.pdf")
+    fig.suptitle(f"[{dtype}][n×{n_cols}][{n_cols}]{variant} => n ")
+    fig.savefig(f"out_plots/{dtype}_{n_cols}_cols{variant}.pdf")
+
+# Horizontal add vs register-transpose reduction, and the rows where the
+# transpose kernel wins, to update use_transpose_kernel in simd.hpp
+for key in kernels:
+    dtype, n_cols = key
+    if len(kernels[key]) != 2:
+        continue
+    n_rows, t_h = np.array(sorted(kernels[key]["hadd_"])).T
+    _, t_t = np.array(sorted(kernels[key]["trsp_"])).T
+
+    faster = n_rows[t_t < t_h].astype(int)
+    print(f"[{dtype}][n×{n_cols}][{n_cols}] => n : transpose faster for rows:")
+    print(" ".join(str(n) for n in faster))
+
+    fig, axes = plt.subplots(ncols=2, figsize=(10, 5))
+    axes[0].plot(n_rows, t_h, label="hadd")
+    axes[0].plot(n_rows, t_t, label="transpose")
+    axes[0].legend()
+    axes[0].set_ylim(ymin=0)
+    axes[0].set_xlabel("n rows")
+    axes[0].set_title("absolute time")
+    axes[1].plot(n_rows, t_h / t_t)
+    axes[1].axhline(1, color="black", linewidth=0.8)
+    axes[1].set_xlabel("n rows")
+    axes[1].set_title("speedup of transpose over hadd")
+
+    fig.suptitle(f"[{dtype}][n×{n_cols}][{n_cols}] => n (reduction)")
+    fig.savefig(f"out_plots/{dtype}_{n_cols}_cols_kernels.pdf")
+
+# Latency: median line, p10-p90 band, p99 dashed, p99.9 dotted
+for key in latency:
+    dtype, n_cols, mode = key
+
+    fig, ax = plt.subplots(figsize=(10, 5))
+    for method, label in (("eigen", "eigen"), ("blaze", "blaze"), ("simd_", "simd")):
+        if method not in latency[key]:
+            continue
+        res = np.array(sorted(latency[key][method])).T
+        n_rows, p10, p50, p90, p99, p999 = res
+
+        (line,) = ax.plot(n_rows, p50, label=f"{label} p50")
+        ax.fill_between(n_rows, p10, p90, color=line.get_color(), alpha=0.2)
+        ax.plot(n_rows, p99, "--", color=line.get_color(), label=f"{label} p99")
+        ax.plot(n_rows, p999, ":", color=line.get_color(), label=f"{label} p99.9")
+
+    ax.legend()
+    ax.set_ylim(ymin=0)
+    ax.set_xlabel("n rows")
+    ax.set_ylabel("ns per call")
+    ax.set_title(f"[{dtype}][n×{n_cols}][{n_cols}] => n ({mode} cache latency)")
+    fig.savefig(f"out_plots/{dtype}_{n_cols}_cols_latency_{mode}.pdf")
+
+# Production profile: calls and cycles per call for each shape hit
+for key in profile:
+    dtype, n_cols = key
+    shapes = sorted(profile[key], key=lambda s: (s[0] < 0, s[0]))
+    labels = [str(s[0]) if s[0] >= 0 else "more" for s in shapes]
+
+    fig, axes = plt.subplots(nrows=2, figsize=(10, 7), sharex=True)
+    axes[0].bar(labels, [s[1] for s in shapes])
+    axes[0].set_title("calls")
+    axes[1].bar(labels, [s[2] for s in shapes])
+    axes[1].set_title("cycles per call")
+    axes[1].set_xlabel("n rows")
+
+    fig.suptitle(f"[{dtype}][n×{n_cols}][{n_cols}] => n (instrumented)")
+    fig.savefig(f"out_plots/{dtype}_{n_cols}_cols_profile.pdf")
@@ -0,0 +1,166 @@
+#ifndef INCLUDE_ARENA
+#define INCLUDE_ARENA
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "utility.hpp"
+
+constexpr std::size_t HugePageSize = std::size_t{2} << 20U;
+constexpr std::size_t ArenaRegionSize = std::size_t{64} << 20U;
+
+INLINE constexpr std::size_t round_up(std::size_t n, std::size_t align) {
+  return (n + align - 1) & ~(align - 1);
+}
+
+// Bump allocator for batches of small matrices and vectors.
+// Storage comes from large anonymous mappings, aligned to 2MiB and advised
+// MADV_HUGEPAGE, so a batch spans a handful of TLB entries instead of being
+// scattered across the heap.
+// Every allocation starts on an `alignment` byte boundary. With `padded`,
+// sizes are also rounded up to the alignment so that two objects never share
+// a cache line. Nothing is freed individually: reset() rewinds the arena and
+// keeps the regions for the next batch.
+class arena {
+public:
+  explicit arena(
+      std::size_t alignment = 64,
+      bool padded = true,
+      std::size_t region_bytes = ArenaRegionSize)
+      : alignment_{alignment},
+        padded_{padded},
+        region_bytes_{round_up(region_bytes, HugePageSize)} {
+    if (alignment == 0 or (alignment & (alignment - 1)) != 0 or
+        alignment > HugePageSize) {
+      throw std::invalid_argument("arena: alignment must be a power of two");
+    }
+  }
+
+  arena(arena&& other) noexcept
+      : alignment_{other.alignment_},
+        padded_{other.padded_},
+        region_bytes_{other.region_bytes_},
+        regions_{std::move(other.regions_)},
+        current_{other.current_},
+        offset_{other.offset_} {
+    other.regions_.clear();
+  }
+  arena& operator=(arena&& other) noexcept {
+    std::swap(alignment_, other.alignment_);
+    std::swap(padded_, other.padded_);
+    std::swap(region_bytes_, other.region_bytes_);
+    std::swap(regions_, other.regions_);
+    std::swap(current_, other.current_);
+    std::swap(offset_, other.offset_);
+    return *this;
+  }
+  arena(arena const&) = delete;
+  arena& operator=(arena const&) = delete;
+
+  ~arena() {
+    for (auto const& r : regions_) {
+      ::munmap(r.base, r.size);
+    }
+  }
+
+  void* allocate(std::size_t bytes) {
+    std::size_t size = padded_ ? round_up(bytes, alignment_) : bytes;
+    while (true) {
+      if (current_ < regions_.size()) {
+        std::size_t offset = round_up(offset_, alignment_);
+        if (offset + size <= regions_[current_].size) {
+          offset_ = offset + size;
+          return regions_[current_].base + offset;
+        }
+        ++current_;
+        offset_ = 0;
+      } else {
+        add_region(std::max(size, region_bytes_));
+      }
+    }
+  }
+
+  // Uninitialized storage for n elements
+  template <typename T> T* allocate_n(std::size_t n) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    return static_cast<T*>(allocate(n * sizeof(T)));
+  }
+
+  // Constructs a U in the arena. Destructors are never run, so U must not
+  // own resources
+  template <typename U, typename... Args> U* make(Args&&... args) {
+    static_assert(std::is_trivially_destructible_v<U>);
+    static_assert(alignof(U) <= HugePageSize);
+    std::size_t align = std::max(alignment_, alignof(U));
+    offset_ = round_up(offset_, align);
+    return new (allocate(sizeof(U))) U(std::forward<Args>(args)...);
+  }
+
+  // Rewinds to the first region; previously returned storage is invalidated
+  void reset() {
+    current_ = 0;
+    offset_ = 0;
+  }
+
+  std::size_t alignment() const { return alignment_; }
+  std::size_t capacity() const {
+    std::size_t total = 0;
+    for (auto const& r : regions_) {
+      total += r.size;
+    }
+    return total;
+  }
+
+private:
+  struct region {
+    char* base;
+    std::size_t size;
+  };
+
+  void add_region(std::size_t bytes) {
+    bytes = round_up(bytes, HugePageSize);
+    // Over-map by one huge page and trim, so the region is 2MiB aligned and
+    // can be backed by huge pages from its first byte
+    std::size_t mapped = bytes + HugePageSize;
+    void* p = ::mmap(
+        nullptr,
+        mapped,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        -1,
+        0);
+    if (p == MAP_FAILED) {
+      throw_errno("mmap");
+    }
+    auto raw = reinterpret_cast<std::uintptr_t>(p);
+    auto aligned = round_up(raw, HugePageSize);
+    if (aligned != raw) {
+      ::munmap(p, aligned - raw);
+    }
+    if (aligned + bytes != raw + mapped) {
+      ::munmap(
+          reinterpret_cast<void*>(aligned + bytes),
+          raw + mapped - (aligned + bytes));
+    }
+    char* base = reinterpret_cast<char*>(aligned);
+#ifdef MADV_HUGEPAGE
+    ::madvise(base, bytes, MADV_HUGEPAGE);
+#endif
+    regions_.push_back({base, bytes});
+    offset_ = 0;
+  }
+
+  std::size_t alignment_;
+  bool padded_;
+  std::size_t region_bytes_;
+  std::vector<region> regions_;
+  std::size_t current_ = 0;
+  std::size_t offset_ = 0;
+};
+#endif
@@ -0,0 +1,249 @@
+#ifndef INCLUDE_BATCH
+#define INCLUDE_BATCH
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "simd.hpp"
+
+// One matvec of a heterogeneous batch, with the kernel type-erased
+struct batch_job {
+  using kernel_t = void (*)(void const*, void const*, void*, std::size_t);
+
+  kernel_t kernel;
+  void const* mat;
+  void const* in;
+  void* out;
+  std::size_t n_rows;
+  std::uint32_t shape; // (type, n_cols), equal shapes share a kernel table
+  std::size_t cost;    // estimated bytes touched
+
+  void operator()() const { kernel(mat, in, out, n_rows); }
+};
+
+template <typename T, int n_cols>
+void batch_kernel(
+    void const* mat, void const* in, void* out, std::size_t n_rows) {
+  matvec_simd_n(
+      static_cast<T const*>(mat),
+      static_cast<T const*>(in),
+      static_cast<T*>(out),
+      n_rows,
+      int_constant<n_cols>{});
+}
+
+// Fixed cost of a call, in bytes, so that tiny jobs are not free
+constexpr std::size_t BatchCallCost = 64;
+
+template <int n_cols, typename T>
+batch_job make_job(T const* mat, T const* in, T* out, std::size_t n_rows) {
+  static_assert(std::is_same_v<T, f32> or std::is_same_v<T, f64>);
+  return {
+      &batch_kernel<T, n_cols>,
+      mat,
+      in,
+      out,
+      n_rows,
+      static_cast<std::uint32_t>(sizeof(T) * 16 + n_cols),
+      BatchCallCost + (n_rows * n_cols + n_cols + n_rows) * sizeof(T)};
+}
+
+// Orders jobs so that consecutive calls run the same kernel instantiation
+inline void sort_by_shape(std::vector<batch_job>& jobs) {
+  std::sort(
+      jobs.begin(), jobs.end(), [](batch_job const& a, batch_job const& b) {
+        if (a.shape != b.shape) {
+          return a.shape < b.shape;
+        }
+        return a.n_rows % MaxStaticRows < b.n_rows % MaxStaticRows;
+      });
+}
+
+// Persistent pool running batches of jobs.
+// run() sorts the batch by shape, cuts it into tasks of similar estimated
+// cost and hands each worker a contiguous range of tasks in its own deque.
+// Workers pop from the front of their deque and, once it is empty, steal
+// from the back of the others, so neighbouring jobs tend to stay on the same
+// core. The calling thread takes part as worker 0.
+class batch_executor {
+public:
+  explicit batch_executor(
+      unsigned n_threads = std::max(1U, std::thread::hardware_concurrency()))
+      : queues_(std::max(1U, n_threads)) {
+    for (unsigned id = 1; id < queues_.size(); ++id) {
+      threads_.emplace_back([this, id] { worker_loop(id); });
+    }
+  }
+
+  batch_executor(batch_executor const&) = delete;
+  batch_executor& operator=(batch_executor const&) = delete;
+
+  ~batch_executor() {
+    {
+      std::lock_guard<std::mutex> guard{lock_};
+      stop_ = true;
+    }
+    start_.notify_all();
+    for (auto& t : threads_) {
+      t.join();
+    }
+  }
+
+  std::size_t size() const { return queues_.size(); }
+
+  // Tasks per worker; more tasks balance better but cost more queue traffic
+  static constexpr std::size_t TasksPerWorker = 8;
+
+  // Sorts jobs in place and runs them with work stealing
+  void run(std::vector<batch_job>& jobs) {
+    sort_by_shape(jobs);
+
+    std::size_t total = 0;
+    for (auto const& j : jobs) {
+      total += j.cost;
+    }
+    std::size_t n = queues_.size();
+    std::size_t grain = std::max<std::size_t>(1, total / (n * TasksPerWorker));
+
+    std::vector<std::pair<std::size_t, task> > tasks;
+    std::size_t first = 0;
+    std::size_t acc = 0;
+    std::size_t done = 0;
+    for (std::size_t i = 0; i < jobs.size(); ++i) {
+      acc += jobs[i].cost;
+      if (acc >= grain or i + 1 == jobs.size()) {
+        // Owner of the task is the worker whose cost share it starts in
+        std::size_t owner = std::min(n - 1, done * n / total);
+        tasks.push_back({owner, {jobs.data(), first, i + 1}});
+        done += acc;
+        acc = 0;
+        first = i + 1;
+      }
+    }
+    launch(tasks, true);
+  }
+
+  // Baseline: jobs split into equal counts per worker, in the given order
+  void run_static(std::vector<batch_job> const& jobs) {
+    std::size_t n = queues_.size();
+    std::vector<std::pair<std::size_t, task> > tasks;
+    for (std::size_t w = 0; w < n; ++w) {
+      std::size_t first = jobs.size() * w / n;
+      std::size_t last = jobs.size() * (w + 1) / n;
+      if (first != last) {
+        tasks.push_back({w, {jobs.data(), first, last}});
+      }
+    }
+    launch(tasks, false);
+  }
+
+private:
+  struct task {
+    batch_job const* jobs;
+    std::size_t first;
+    std::size_t last;
+  };
+
+  struct alignas(64) worker_queue {
+    std::mutex lock;
+    std::deque<task> tasks;
+  };
+
+  // A worker still finishing the previous batch may already see these
+  // tasks, so the counter is set before they are published
+  void launch(
+      std::vector<std::pair<std::size_t, task> > const& tasks, bool steal) {
+    if (tasks.empty()) {
+      return;
+    }
+    steal_.store(steal, std::memory_order_relaxed);
+    remaining_.store(tasks.size(), std::memory_order_relaxed);
+    for (auto const& [owner, t] : tasks) {
+      std::lock_guard<std::mutex> guard{queues_[owner].lock};
+      queues_[owner].tasks.push_back(t);
+    }
+    {
+      std::lock_guard<std::mutex> guard{lock_};
+      ++generation_;
+    }
+    start_.notify_all();
+
+    work(0);
+
+    std::unique_lock<std::mutex> guard{lock_};
+    finished_.wait(guard, [this] {
+      return remaining_.load(std::memory_order_acquire) == 0;
+    });
+  }
+
+  void worker_loop(unsigned id) {
+    std::uint64_t seen = 0;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> guard{lock_};
+        start_.wait(guard, [&] { return stop_ or generation_ != seen; });
+        if (stop_) {
+          return;
+        }
+        seen = generation_;
+      }
+      work(id);
+    }
+  }
+
+  bool pop(std::size_t id, task& t) {
+    auto& q = queues_[id];
+    std::lock_guard<std::mutex> guard{q.lock};
+    if (q.tasks.empty()) {
+      return false;
+    }
+    t = q.tasks.front();
+    q.tasks.pop_front();
+    return true;
+  }
+
+  bool steal(std::size_t id, task& t) {
+    for (std::size_t k = 1; k < queues_.size(); ++k) {
+      auto& q = queues_[(id + k) % queues_.size()];
+      std::lock_guard<std::mutex> guard{q.lock};
+      if (not q.tasks.empty()) {
+        t = q.tasks.back();
+        q.tasks.pop_back();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void work(std::size_t id) {
+    task t{};
+    while (pop(id, t) or
+           (steal_.load(std::memory_order_relaxed) and steal(id, t))) {
+      for (std::size_t i = t.first; i < t.last; ++i) {
+        t.jobs[i]();
+      }
+      if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        std::lock_guard<std::mutex> guard{lock_};
+        finished_.notify_all();
+      }
+    }
+  }
+
+  std::vector<worker_queue> queues_;
+  std::vector<std::thread> threads_;
+
+  std::mutex lock_;
+  std::condition_variable start_;
+  std::condition_variable finished_;
+  std::uint64_t generation_ = 0;
+  bool stop_ = false;
+  std::atomic<bool> steal_{true};
+  std::atomic<std::size_t> remaining_{0};
+};
+#endif
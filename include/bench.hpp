@@ -1,20 +1,36 @@
 #ifndef INCLUDE_BENCH
 #define INCLUDE_BENCH
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <fstream>
 #include <iostream>
 
 #include "benchmark/benchmark.h"
 
+#include "blaze/math/CustomMatrix.h"
+#include "blaze/math/CustomVector.h"
 #include "blaze/math/StaticMatrix.h"
 #include "blaze/math/StaticVector.h"
 
 #include "Eigen/Core"
 
+#include "arena.hpp"
+#include "latency.hpp"
 #include "simd.hpp"
 
+#ifdef MATVEC_HOOK
+#include "hook.hpp"
+#endif
+
 #define SWALLOW_SEMICOLON struct unused_with_placeholder_id_##__LINE__
 
+// Calls timed individually by the latency benchmarks
+#ifndef LATENCY_SAMPLES
+#define LATENCY_SAMPLES 100000
+#endif
+
 #ifdef BM_EIGEN
 #define BENCH_EIGEN(...)                                                       \
   BENCHMARK_TEMPLATE(__VA_ARGS__);                                             \
@@ -39,6 +55,17 @@
 #define BENCH_SIMD_(...) SWALLOW_SEMICOLON
 #endif
 
+// Horizontal add and register-transpose kernels, forced regardless of
+// use_transpose_kernel. Only defined for the f32×8 and f64×4 targets, the
+// widths with a transpose kernel
+#ifdef BM_KERNELS
+#define BENCH_KERN_(...)                                                       \
+  BENCHMARK_TEMPLATE(__VA_ARGS__);                                             \
+  SWALLOW_SEMICOLON
+#else
+#define BENCH_KERN_(...) SWALLOW_SEMICOLON
+#endif
+
 template <
     typename T,                                                          //
     int n_rows,                                                          //
@@ -57,6 +84,53 @@ using Mat = blaze::StaticMatrix< //
 template <typename T, int size>
 using Vec = blaze::StaticVector<T, size, blaze::columnVector, blaze::unaligned>;
 
+template <typename T>
+using CustomMat = blaze::CustomMatrix< //
+    T,                                //
+    blaze::unaligned,                 //
+    blaze::unpadded,                  //
+    blaze::rowMajor                   //
+    >;
+
+template <typename T>
+using CustomVec = blaze::CustomVector< //
+    T,                                 //
+    blaze::unaligned,                  //
+    blaze::unpadded,                   //
+    blaze::columnVector                //
+    >;
+
+// Blaze views over externally owned storage, e.g. from an arena. The extents
+// are also static members, as with Mat/Vec, so the views can be passed to
+// matvec::prod
+template <typename T, int n_rows, int n_cols>
+struct MatView : CustomMat<T> {
+  using CustomMat<T>::operator=;
+
+  explicit MatView(T* data) : CustomMat<T>(data, n_rows, n_cols) {}
+
+  static constexpr std::size_t rows() { return n_rows; }
+  static constexpr std::size_t columns() { return n_cols; }
+};
+
+template <typename T, int length> struct VecView : CustomVec<T> {
+  using CustomVec<T>::operator=;
+
+  explicit VecView(T* data) : CustomVec<T>(data, length) {}
+
+  static constexpr std::size_t size() { return length; }
+};
+
+template <typename T, int n_rows, int n_cols>
+MatView<T, n_rows, n_cols> arena_mat(arena& a) {
+  return MatView<T, n_rows, n_cols>(
+      a.allocate_n<T>(static_cast<std::size_t>(n_rows * n_cols)));
+}
+
+template <typename T, int size> VecView<T, size> arena_vec(arena& a) {
+  return VecView<T, size>(a.allocate_n<T>(static_cast<std::size_t>(size)));
+}
+
 template <typename T> auto row_maj_view(T&& mat) {
   using namespace Eigen;
   using U = naked_type<T>;
@@ -73,6 +147,34 @@ template <typename T> auto vec_view(T&& mat) {
   return Map<const_like<Matrix<E, U::size(), 1>, T>, Unaligned>{mat.data()};
 }
 
+// Largest error of out against the product of mat (rows ld elements apart)
+// with in, taken in long double. Each row is scaled by sum_j |mat_ij in_j|,
+// so a dot product of length n_cols rounded in T stays within
+// n_cols * epsilon<T>
+template <typename T, typename Out>
+double max_rel_err(
+    T const* mat,
+    std::size_t ld,
+    T const* in,
+    Out const* out,
+    std::size_t n_rows,
+    std::size_t n_cols) {
+  long double err = 0;
+  for (std::size_t i = 0; i < n_rows; ++i) {
+    long double exact = 0;
+    long double scale = 0;
+    for (std::size_t j = 0; j < n_cols; ++j) {
+      long double p = static_cast<long double>(mat[i * ld + j]) *
+                      static_cast<long double>(in[j]);
+      exact += p;
+      scale += std::fabs(p);
+    }
+    long double diff = std::fabs(static_cast<long double>(out[i]) - exact);
+    err = std::max(err, scale > 0 ? diff / scale : diff);
+  }
+  return static_cast<double>(err);
+}
+
 struct eigen_ {
   template <typename T, typename In, typename Out>
   NOINLINE static void //
@@ -93,6 +195,16 @@ struct matvec {
   NOINLINE static void //
   prod(T const& matrix, In const& in, Out& out);
 };
+struct matvec_hadd_ {
+  template <typename T, typename In, typename Out>
+  NOINLINE static void //
+  prod(T const& matrix, In const& in, Out& out);
+};
+struct matvec_trsp_ {
+  template <typename T, typename In, typename Out>
+  NOINLINE static void //
+  prod(T const& matrix, In const& in, Out& out);
+};
 
 template <typename T, typename In, typename Out>
 void eigen_::prod(T const& matrix, In const& in, Out& out) {
@@ -124,6 +236,7 @@ void loop_::prod(T const& matrix, In const& in, Out& out) {
 
 template <typename T, typename In, typename Out>
 void matvec::prod(T const& matrix, In const& in, Out& out) {
+  MATVEC_PROFILE(typename T::ElementType, T::rows(), T::columns());
   matvec_simd<T::rows()>(          //
       matrix.data(),               //
       in.data(),                   //
@@ -132,6 +245,26 @@ void matvec::prod(T const& matrix, In const& in, Out& out) {
   );
 }
 
+template <typename T, typename In, typename Out>
+void matvec_hadd_::prod(T const& matrix, In const& in, Out& out) {
+  matvec_simd_hadd<T::rows()>(     //
+      matrix.data(),               //
+      in.data(),                   //
+      out.data(),                  //
+      int_constant<T::columns()>{} //
+  );
+}
+
+template <typename T, typename In, typename Out>
+void matvec_trsp_::prod(T const& matrix, In const& in, Out& out) {
+  matvec_simd_transpose<T::rows()>( //
+      matrix.data(),                //
+      in.data(),                    //
+      out.data(),                   //
+      int_constant<T::columns()>{}  //
+  );
+}
+
 template <typename Method, typename T, int n_rows, int n_cols>
 void bm(benchmark::State& state) {
   alignas(32) Mat<T, n_rows, n_cols> mat{};
@@ -166,6 +299,74 @@ NOINLINE void bm_simd_(benchmark::State& state) {
   bm<matvec, T, n_rows, n_cols>(state);
 }
 
+template <typename T, int n_rows, int n_cols>
+NOINLINE void bm_hadd_(benchmark::State& state) {
+  bm<matvec_hadd_, T, n_rows, n_cols>(state);
+}
+
+template <typename T, int n_rows, int n_cols>
+NOINLINE void bm_trsp_(benchmark::State& state) {
+  bm<matvec_trsp_, T, n_rows, n_cols>(state);
+}
+
+// Times every call separately instead of averaging over the loop.
+// With Cold, the operands are flushed from the cache before each call
+template <typename Method, bool Cold, typename T, int n_rows, int n_cols>
+void bm_latency(benchmark::State& state) {
+  alignas(32) Mat<T, n_rows, n_cols> mat{};
+  alignas(32) Vec<T, n_cols> in{};
+  alignas(32) Vec<T, n_rows> out{};
+  latency_stats stats;
+  stats.samples.reserve(LATENCY_SAMPLES);
+  tsc_overhead();
+  tsc_per_ns();
+
+  for (const auto& _ : state) {
+    unused(_);
+    benchmark::DoNotOptimize(mat);
+    benchmark::DoNotOptimize(in);
+    benchmark::DoNotOptimize(out);
+    if constexpr (Cold) {
+      flush_cache(mat.data(), sizeof(T) * n_rows * n_cols);
+      flush_cache(in.data(), sizeof(T) * n_cols);
+      flush_cache(out.data(), sizeof(T) * n_rows);
+    }
+    std::uint64_t t0 = tsc_start();
+    Method::prod(mat, in, out);
+    std::uint64_t t1 = tsc_stop();
+    stats.add(t0, t1);
+    benchmark::ClobberMemory();
+  }
+  stats.report(state.counters);
+}
+
+template <typename T, int n_rows, int n_cols>
+NOINLINE void bm_lat_warm_eigen(benchmark::State& state) {
+  bm_latency<eigen_, false, T, n_rows, n_cols>(state);
+}
+template <typename T, int n_rows, int n_cols>
+NOINLINE void bm_lat_warm_blaze(benchmark::State& state) {
+  bm_latency<blaze_, false, T, n_rows, n_cols>(state);
+}
+template <typename T, int n_rows, int n_cols>
+NOINLINE void bm_lat_warm_simd_(benchmark::State& state) {
+  bm_latency<matvec, false, T, n_rows, n_cols>(state);
+}
+template <typename T, int n_rows, int n_cols>
+NOINLINE void bm_lat_cold_eigen(benchmark::State& state) {
+  bm_latency<eigen_, true, T, n_rows, n_cols>(state);
+}
+template <typename T, int n_rows, int n_cols>
+NOINLINE void bm_lat_cold_blaze(benchmark::State& state) {
+  bm_latency<blaze_, true, T, n_rows, n_cols>(state);
+}
+template <typename T, int n_rows, int n_cols>
+NOINLINE void bm_lat_cold_simd_(benchmark::State& state) {
+  bm_latency<matvec, true, T, n_rows, n_cols>(state);
+}
+
+// Output directory of the benchmarks (BENCH_OUT), created if missing
+std::string bench_out_dir();
 void run_bench(const std::string& name);
 
 #define EXTERN_TPL(T, NRows, NCols)                                            \
@@ -210,6 +411,20 @@ void run_bench(const std::string& name);
 #define RUN_BENCHMARKS(T, NCols, NRows)                                        \
   BENCH_BLAZE(bm_blaze, T, (NRows), (NCols));                                  \
   BENCH_EIGEN(bm_eigen, T, (NRows), (NCols));                                  \
-  BENCH_SIMD_(bm_simd_, T, (NRows), (NCols))
+  BENCH_SIMD_(bm_simd_, T, (NRows), (NCols));                                  \
+  BENCH_KERN_(bm_hadd_, T, (NRows), (NCols));                                  \
+  BENCH_KERN_(bm_trsp_, T, (NRows), (NCols))
+
+#define RUN_LATENCY_BENCHMARKS_(Mode, T, NCols, NRows)                         \
+  BENCHMARK_TEMPLATE(bm_lat_##Mode##_blaze, T, (NRows), (NCols))               \
+      ->Iterations(LATENCY_SAMPLES);                                           \
+  BENCHMARK_TEMPLATE(bm_lat_##Mode##_eigen, T, (NRows), (NCols))               \
+      ->Iterations(LATENCY_SAMPLES);                                           \
+  BENCHMARK_TEMPLATE(bm_lat_##Mode##_simd_, T, (NRows), (NCols))               \
+      ->Iterations(LATENCY_SAMPLES)
+
+#define RUN_LATENCY_BENCHMARKS(T, NCols, NRows)                                \
+  RUN_LATENCY_BENCHMARKS_(warm, T, NCols, NRows);                              \
+  RUN_LATENCY_BENCHMARKS_(cold, T, NCols, NRows)
 
 #endif
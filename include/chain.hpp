@@ -0,0 +1,87 @@
+#ifndef INCLUDE_CHAIN
+#define INCLUDE_CHAIN
+#include <array>
+#include <cstddef>
+#include <tuple>
+
+#include "simd.hpp"
+
+// Element-wise functions applied to a layer's output
+struct identity_ {
+  template <typename T> INLINE static void apply(T*, int) {}
+};
+struct relu_ {
+  template <typename T> INLINE static void apply(T* data, int n) {
+    for (int i = 0; i < n; ++i) {
+      data[i] = data[i] > T(0) ? data[i] : T(0);
+    }
+  }
+};
+
+// [n_out][n_in] row-major layer followed by Epilogue
+template <int N_Out, int N_In, typename Epilogue = identity_> struct layer {
+  static constexpr int n_out = N_Out;
+  static constexpr int n_in = N_In;
+  using epilogue = Epilogue;
+
+  static_assert(N_Out > 0 and N_In > 0);
+  static_assert(n_in == 2 or n_in == 4 or n_in == 8);
+};
+
+// Fused evaluation of out = Ln(...L2(L1(in))).
+// Every kernel is inlined into a single function, and since each hidden
+// layer is at most 8 wide, its output is a small local array that the
+// compiler keeps in registers instead of writing it back to memory.
+template <typename... Layers> struct layer_chain {
+  static constexpr std::size_t n_layers = sizeof...(Layers);
+  static_assert(n_layers > 0);
+
+  template <std::size_t I>
+  using layer_at = std::tuple_element_t<I, std::tuple<Layers...> >;
+
+  static constexpr int n_in = layer_at<0>::n_in;
+  static constexpr int n_out = layer_at<n_layers - 1>::n_out;
+
+  template <typename T> using weights_t = std::array<T const*, n_layers>;
+
+  // One input vector
+  template <typename T>
+  NOINLINE static void
+  prod(weights_t<T> const& weights, T const* in_data, T* out_data) {
+    run<0>(weights, in_data, out_data);
+  }
+
+  // n_vecs inputs and outputs, stored contiguously
+  template <typename T>
+  NOINLINE static void prod_batch(
+      weights_t<T> const& weights,
+      T const* in_data,
+      T* out_data,
+      std::size_t n_vecs) {
+    for (std::size_t v = 0; v < n_vecs; ++v) {
+      run<0>(weights, in_data + v * n_in, out_data + v * n_out);
+    }
+  }
+
+private:
+  template <std::size_t I, typename T>
+  INLINE static void
+  run(weights_t<T> const& weights, T const* in_data, T* out_data) {
+    using L = layer_at<I>;
+    if constexpr (I + 1 == n_layers) {
+      matvec_simd_best_inline<L::n_out>(
+          weights[I], in_data, out_data, int_constant<L::n_in>{});
+      L::epilogue::apply(out_data, L::n_out);
+    } else {
+      static_assert(
+          L::n_out == layer_at<I + 1>::n_in,
+          "layer output does not match the next layer's input");
+      alignas(32) T hidden[static_cast<std::size_t>(L::n_out)];
+      matvec_simd_best_inline<L::n_out>(
+          weights[I], in_data, hidden, int_constant<L::n_in>{});
+      L::epilogue::apply(hidden, L::n_out);
+      run<I + 1>(weights, hidden, out_data);
+    }
+  }
+};
+#endif
@@ -0,0 +1,179 @@
+#ifndef INCLUDE_COALESCE
+#define INCLUDE_COALESCE
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <iterator>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "simd.hpp"
+
+// Asynchronous front end for many threads multiplying shared matrices.
+// Requests on the same matrix that arrive within `window` of the first
+// pending one (or until `max_batch` are pending) are answered by a single
+// matvec_multi pass, so the matrix is read from memory once per batch
+// instead of once per request.
+template <typename T, int n_cols> class coalescing_dispatcher {
+public:
+  using clock = std::chrono::steady_clock;
+
+  struct matrix_handle {
+    std::size_t id;
+  };
+
+  explicit coalescing_dispatcher(
+      std::chrono::microseconds window = std::chrono::microseconds(50),
+      std::size_t max_batch = 16)
+      : window_{window},
+        max_batch_{std::max<std::size_t>(1, max_batch)},
+        thread_{[this] { dispatch_loop(); }} {}
+
+  coalescing_dispatcher(coalescing_dispatcher const&) = delete;
+  coalescing_dispatcher& operator=(coalescing_dispatcher const&) = delete;
+
+  // Pending requests are still served before the dispatcher exits
+  ~coalescing_dispatcher() {
+    {
+      std::lock_guard<std::mutex> guard{lock_};
+      stop_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+  }
+
+  // The matrix must outlive the dispatcher and stay unchanged while
+  // requests on it are pending
+  matrix_handle add_matrix(T const* mat, std::size_t n_rows) {
+    std::lock_guard<std::mutex> guard{lock_};
+    groups_.push_back({mat, n_rows, {}, {}});
+    return {groups_.size() - 1};
+  }
+
+  // out[0, n_rows) = mat × in. Both buffers must stay valid until the
+  // returned future is ready
+  std::future<void> submit(matrix_handle h, T const* in, T* out) {
+    std::promise<void> done;
+    std::future<void> result = done.get_future();
+    bool notify;
+    {
+      std::lock_guard<std::mutex> guard{lock_};
+      if (h.id >= groups_.size()) {
+        throw std::out_of_range("coalescing_dispatcher: invalid handle");
+      }
+      auto& g = groups_[h.id];
+      if (g.pending.empty()) {
+        g.first_arrival = clock::now();
+      }
+      g.pending.push_back({in, out, std::move(done)});
+      ++n_pending_;
+      // Only a new deadline or a full batch changes what the dispatcher
+      // is waiting for
+      notify = g.pending.size() == 1 or g.pending.size() >= max_batch_;
+    }
+    if (notify) {
+      wake_.notify_one();
+    }
+    return result;
+  }
+
+private:
+  struct request {
+    T const* in;
+    T* out;
+    std::promise<void> done;
+  };
+
+  struct group {
+    T const* mat;
+    std::size_t n_rows;
+    std::vector<request> pending;
+    clock::time_point first_arrival;
+  };
+
+  void dispatch_loop() {
+    std::vector<request> batch;
+    std::vector<T const*> ins;
+    std::vector<T*> outs;
+
+    std::unique_lock<std::mutex> guard{lock_};
+    while (true) {
+      wake_.wait(guard, [this] { return stop_ or n_pending_ != 0; });
+      if (n_pending_ == 0) {
+        return;
+      }
+
+      // Full group first, otherwise the one with the earliest deadline
+      group* ready = nullptr;
+      group* earliest = nullptr;
+      for (auto& g : groups_) {
+        if (g.pending.empty()) {
+          continue;
+        }
+        if (g.pending.size() >= max_batch_) {
+          ready = &g;
+          break;
+        }
+        if (earliest == nullptr or g.first_arrival < earliest->first_arrival) {
+          earliest = &g;
+        }
+      }
+      if (ready == nullptr) {
+        auto deadline = earliest->first_arrival + window_;
+        if (not stop_ and clock::now() < deadline) {
+          wake_.wait_until(guard, deadline);
+          continue;
+        }
+        ready = earliest;
+      }
+
+      std::size_t n = std::min(ready->pending.size(), max_batch_);
+      batch.clear();
+      std::move(
+          ready->pending.begin(),
+          ready->pending.begin() + static_cast<std::ptrdiff_t>(n),
+          std::back_inserter(batch));
+      ready->pending.erase(
+          ready->pending.begin(),
+          ready->pending.begin() + static_cast<std::ptrdiff_t>(n));
+      n_pending_ -= n;
+      T const* mat = ready->mat;
+      std::size_t n_rows = ready->n_rows;
+      guard.unlock();
+
+      ins.clear();
+      outs.clear();
+      for (auto& r : batch) {
+        ins.push_back(r.in);
+        outs.push_back(r.out);
+      }
+      matvec_multi(
+          mat,
+          ins.data(),
+          outs.data(),
+          static_cast<int>(n),
+          n_rows,
+          int_constant<n_cols>{});
+      for (auto& r : batch) {
+        r.done.set_value();
+      }
+
+      guard.lock();
+    }
+  }
+
+  std::chrono::microseconds window_;
+  std::size_t max_batch_;
+
+  std::mutex lock_;
+  std::condition_variable wake_;
+  std::vector<group> groups_;
+  std::size_t n_pending_ = 0;
+  bool stop_ = false;
+
+  std::thread thread_;
+};
+#endif
@@ -0,0 +1,161 @@
+#ifndef INCLUDE_HOOK
+#define INCLUDE_HOOK
+#include <type_traits>
+
+#include "blaze/math/expressions/DMatDVecMultExpr.h"
+#include "blaze/math/typetraits/IsColumnVector.h"
+#include "blaze/math/typetraits/IsDenseMatrix.h"
+#include "blaze/math/typetraits/IsDenseVector.h"
+#include "blaze/math/typetraits/IsPadded.h"
+#include "blaze/math/typetraits/IsRowMajorMatrix.h"
+#include "blaze/math/typetraits/IsStatic.h"
+
+#include "Eigen/Core"
+
+#include "simd.hpp"
+
+// Opt-in routing of small Blaze and Eigen matrix-vector products to
+// matvec_simd, for row-major {f32, f64} matrices with 2, 4 or 8 columns.
+// Every translation unit that instantiates such a product must agree on
+// whether this header is included, otherwise the same Blaze/Eigen templates
+// get two different definitions. bench.hpp includes it when MATVEC_HOOK is
+// defined.
+
+namespace matvec_hook {
+template <typename T>
+constexpr bool is_kernel_type =
+    std::is_same_v<T, f32> or std::is_same_v<T, f64>;
+
+constexpr bool is_kernel_width(int n_cols) {
+  return n_cols == 2 or n_cols == 4 or n_cols == 8;
+}
+
+// out = mat * in with out, mat and in static Blaze types, mat row-major and
+// densely packed
+template <typename Out, typename M, typename In>
+constexpr bool blaze_applies() {
+  using namespace blaze;
+  if constexpr (
+      IsStatic_v<Out> and IsDenseVector_v<Out> and IsColumnVector_v<Out> and
+      IsStatic_v<M> and IsDenseMatrix_v<M> and IsRowMajorMatrix_v<M> and
+      not IsPadded_v<M> and IsStatic_v<In> and IsDenseVector_v<In>) {
+    using T = typename M::ElementType;
+    return is_kernel_type<T> and
+           std::is_same_v<T, typename Out::ElementType> and
+           std::is_same_v<T, typename In::ElementType> and
+           is_kernel_width(static_cast<int>(M::columns()));
+  } else {
+    return false;
+  }
+}
+} // namespace matvec_hook
+
+namespace blaze {
+// Found by ADL from the assignment operators of the static vector types.
+// Binding Out& directly ranks above the DenseVector<VT, false>& overload the
+// expression template declares for itself
+template <typename Out, typename M, typename In>
+inline std::enable_if_t<matvec_hook::blaze_applies<Out, M, In>()>
+assign(Out& lhs, DMatDVecMultExpr<M, In> const& rhs) {
+  auto const& mat = rhs.leftOperand();
+  auto const& in = rhs.rightOperand();
+  matvec_simd<static_cast<int>(M::rows())>(
+      mat.data(),
+      in.data(),
+      lhs.data(),
+      int_constant<static_cast<int>(M::columns())>{});
+}
+} // namespace blaze
+
+namespace Eigen {
+namespace internal {
+// dst (op)= lhs * rhs with lhs a row-major fixed size matrix map and rhs a
+// fixed size vector map, as built by row_maj_view/vec_view
+template <typename Lhs, typename Rhs> struct matvec_product_impl {
+  using Scalar = typename Lhs::Scalar;
+  static constexpr int n_rows = Lhs::RowsAtCompileTime;
+  static constexpr int n_cols = Lhs::ColsAtCompileTime;
+
+  template <typename Dst>
+  static void evalTo(Dst& dst, Lhs const& lhs, Rhs const& rhs) {
+    if constexpr (Dst::InnerStrideAtCompileTime == 1) {
+      matvec_simd<n_rows>(
+          lhs.data(), rhs.data(), dst.data(), int_constant<n_cols>{});
+    } else {
+      Matrix<Scalar, n_rows, 1> tmp;
+      matvec_simd<n_rows>(
+          lhs.data(), rhs.data(), tmp.data(), int_constant<n_cols>{});
+      dst = tmp;
+    }
+  }
+
+  template <typename Dst>
+  static void addTo(Dst& dst, Lhs const& lhs, Rhs const& rhs) {
+    Matrix<Scalar, n_rows, 1> tmp;
+    matvec_simd<n_rows>(
+        lhs.data(), rhs.data(), tmp.data(), int_constant<n_cols>{});
+    dst += tmp;
+  }
+
+  template <typename Dst>
+  static void subTo(Dst& dst, Lhs const& lhs, Rhs const& rhs) {
+    Matrix<Scalar, n_rows, 1> tmp;
+    matvec_simd<n_rows>(
+        lhs.data(), rhs.data(), tmp.data(), int_constant<n_cols>{});
+    dst -= tmp;
+  }
+
+  template <typename Dst>
+  static void scaleAndAddTo(
+      Dst& dst, Lhs const& lhs, Rhs const& rhs, Scalar const& alpha) {
+    Matrix<Scalar, n_rows, 1> tmp;
+    matvec_simd<n_rows>(
+        lhs.data(), rhs.data(), tmp.data(), int_constant<n_cols>{});
+    dst += alpha * tmp;
+  }
+};
+
+// Depending on the row count Eigen picks InnerProduct (one row),
+// CoeffBasedProductMode or, with 8 columns and at least 8 rows, GemvProduct
+#define MATVEC_HOOK_EIGEN_(T, NCols, LhsConst, RhsConst, Tag)                  \
+  template <int NRows, int LhsOpt, int RhsOpt>                                 \
+  struct generic_product_impl<                                                 \
+      Map<LhsConst Matrix<T, NRows, NCols, RowMajor, NRows, NCols>,            \
+          LhsOpt,                                                              \
+          Stride<0, 0> >,                                                      \
+      Map<RhsConst Matrix<T, NCols, 1, 0, NCols, 1>, RhsOpt, Stride<0, 0> >,   \
+      DenseShape,                                                              \
+      DenseShape,                                                              \
+      Tag>                                                                     \
+      : matvec_product_impl<                                                   \
+            Map<LhsConst Matrix<T, NRows, NCols, RowMajor, NRows, NCols>,      \
+                LhsOpt,                                                        \
+                Stride<0, 0> >,                                                \
+            Map<RhsConst Matrix<T, NCols, 1, 0, NCols, 1>,                     \
+                RhsOpt,                                                        \
+                Stride<0, 0> > > {}
+
+#define MATVEC_HOOK_EIGEN_CONST_(T, NCols, Tag)                                \
+  MATVEC_HOOK_EIGEN_(T, NCols, const, const, Tag);                             \
+  MATVEC_HOOK_EIGEN_(T, NCols, const, , Tag);                                  \
+  MATVEC_HOOK_EIGEN_(T, NCols, , const, Tag);                                  \
+  MATVEC_HOOK_EIGEN_(T, NCols, , , Tag)
+
+#define MATVEC_HOOK_EIGEN(T, NCols)                                            \
+  MATVEC_HOOK_EIGEN_CONST_(T, NCols, InnerProduct);                            \
+  MATVEC_HOOK_EIGEN_CONST_(T, NCols, CoeffBasedProductMode);                   \
+  MATVEC_HOOK_EIGEN_CONST_(T, NCols, GemvProduct)
+
+MATVEC_HOOK_EIGEN(f32, 2);
+MATVEC_HOOK_EIGEN(f32, 4);
+MATVEC_HOOK_EIGEN(f32, 8);
+MATVEC_HOOK_EIGEN(f64, 2);
+MATVEC_HOOK_EIGEN(f64, 4);
+MATVEC_HOOK_EIGEN(f64, 8);
+
+#undef MATVEC_HOOK_EIGEN
+#undef MATVEC_HOOK_EIGEN_CONST_
+#undef MATVEC_HOOK_EIGEN_
+} // namespace internal
+} // namespace Eigen
+#endif
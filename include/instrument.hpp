@@ -0,0 +1,162 @@
+#ifndef INCLUDE_INSTRUMENT
+#define INCLUDE_INSTRUMENT
+
+// Opt-in per-shape call counters for production builds.
+// Build with -DMATVEC_INSTRUMENT to enable them; otherwise MATVEC_PROFILE
+// expands to nothing and this header only declares the macro.
+
+#ifdef MATVEC_INSTRUMENT
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <type_traits>
+#include <vector>
+
+#include <x86intrin.h>
+
+#include "utility.hpp"
+
+// Row counts above this share a single slot per (type, n_cols)
+constexpr int InstrumentMaxRows = 128;
+
+// Written by its owning thread only, so plain load/store pairs are enough and
+// the hot path never issues a locked instruction; readers may see a slightly
+// stale value
+struct shape_counters {
+  std::atomic<std::uint64_t> calls{0};
+  std::atomic<std::uint64_t> rows{0};
+  std::atomic<std::uint64_t> cycles{0};
+
+  INLINE static void
+  bump(std::atomic<std::uint64_t>& c, std::uint64_t n) {
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+};
+
+// [f32|f64][2|4|8 columns][0..InstrumentMaxRows, overflow]
+struct thread_counters {
+  shape_counters shapes[2][3][InstrumentMaxRows + 2];
+};
+
+// Tables of every thread that ever made a call. They are never freed, so the
+// counts of finished threads still show up in snapshots
+struct counter_registry {
+  std::mutex lock;
+  std::vector<std::unique_ptr<thread_counters> > tables;
+
+  static counter_registry& get() {
+    static counter_registry r;
+    return r;
+  }
+};
+
+inline thread_counters& local_counters() {
+  thread_local thread_counters* table = [] {
+    auto& r = counter_registry::get();
+    std::lock_guard<std::mutex> guard{r.lock};
+    r.tables.push_back(std::make_unique<thread_counters>());
+    return r.tables.back().get();
+  }();
+  return *table;
+}
+
+template <typename T>
+INLINE shape_counters& counters_for(std::size_t n_rows, int n_cols) {
+  static_assert(std::is_same_v<T, f32> or std::is_same_v<T, f64>);
+  int type_idx = std::is_same_v<T, f32> ? 0 : 1;
+  int col_idx = n_cols == 2 ? 0 : (n_cols == 4 ? 1 : 2);
+  std::size_t row_idx =
+      n_rows <= InstrumentMaxRows ? n_rows : InstrumentMaxRows + 1;
+  return local_counters().shapes[type_idx][col_idx][row_idx];
+}
+
+// Counts one kernel call and the cycles spent until the end of the scope
+template <typename T> class profile_scope {
+public:
+  INLINE profile_scope(std::size_t n_rows, int n_cols)
+      : counters_{counters_for<T>(n_rows, n_cols)},
+        n_rows_{n_rows},
+        start_{__rdtsc()} {}
+  INLINE ~profile_scope() {
+    std::uint64_t end = __rdtsc();
+    shape_counters::bump(counters_.calls, 1);
+    shape_counters::bump(counters_.rows, n_rows_);
+    shape_counters::bump(counters_.cycles, end - start_);
+  }
+  profile_scope(profile_scope const&) = delete;
+  profile_scope& operator=(profile_scope const&) = delete;
+
+private:
+  shape_counters& counters_;
+  std::size_t n_rows_;
+  std::uint64_t start_;
+};
+
+struct shape_stats {
+  char const* type;
+  int n_rows; // -1 for shapes above InstrumentMaxRows
+  int n_cols;
+  std::uint64_t calls;
+  std::uint64_t rows;
+  std::uint64_t cycles;
+};
+
+// Sum over all threads of every shape that was hit at least once
+inline std::vector<shape_stats> profile_snapshot() {
+  constexpr char const* type_names[] = {"f32", "f64"};
+  constexpr int col_counts[] = {2, 4, 8};
+
+  auto& r = counter_registry::get();
+  std::lock_guard<std::mutex> guard{r.lock};
+  std::vector<shape_stats> out;
+  for (int t = 0; t < 2; ++t) {
+    for (int c = 0; c < 3; ++c) {
+      for (int i = 0; i < InstrumentMaxRows + 2; ++i) {
+        shape_stats s{
+            type_names[t],
+            i <= InstrumentMaxRows ? i : -1,
+            col_counts[c],
+            0,
+            0,
+            0};
+        for (auto const& table : r.tables) {
+          auto const& sc = table->shapes[t][c][i];
+          s.calls += sc.calls.load(std::memory_order_relaxed);
+          s.rows += sc.rows.load(std::memory_order_relaxed);
+          s.cycles += sc.cycles.load(std::memory_order_relaxed);
+        }
+        if (s.calls != 0) {
+          out.push_back(s);
+        }
+      }
+    }
+  }
+  return out;
+}
+
+// Same layout as the google benchmark JSON output, so draw_plots.py can read
+// it alongside the benchmark results
+inline void profile_dump(std::ostream& os) {
+  auto stats = profile_snapshot();
+  os << "{\n  \"context\": {\"source\": \"matvec_instrument\"},\n"
+     << "  \"benchmarks\": [";
+  for (std::size_t k = 0; k < stats.size(); ++k) {
+    auto const& s = stats[k];
+    os << (k == 0 ? "\n" : ",\n") << "    {\"name\": \"prof_<" << s.type
+       << ", " << s.n_rows << ", " << s.n_cols << ">\", \"calls\": " << s.calls
+       << ", \"rows\": " << s.rows << ", \"cycles\": " << s.cycles
+       << ", \"cycles_per_call\": "
+       << static_cast<double>(s.cycles) / static_cast<double>(s.calls) << "}";
+  }
+  os << "\n  ]\n}\n";
+}
+
+#define MATVEC_PROFILE(T, NRows, NCols)                                        \
+  profile_scope<T> matvec_profile_scope_ { NRows, NCols }
+#else
+#define MATVEC_PROFILE(T, NRows, NCols) static_cast<void>(0)
+#endif
+
+#endif
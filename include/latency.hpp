@@ -0,0 +1,128 @@
+#ifndef INCLUDE_LATENCY
+#define INCLUDE_LATENCY
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <x86intrin.h>
+
+#include "utility.hpp"
+
+// Number of histogram buckets reported per benchmark
+constexpr int LatencyBuckets = 32;
+
+// Serialized timestamp reads: the lfences keep the timed code from being
+// reordered across the start mark, and rdtscp waits for it to retire before
+// reading the end mark.
+INLINE std::uint64_t tsc_start() {
+  _mm_lfence();
+  std::uint64_t t = __rdtsc();
+  _mm_lfence();
+  return t;
+}
+
+INLINE std::uint64_t tsc_stop() {
+  unsigned aux;
+  std::uint64_t t = __rdtscp(&aux);
+  _mm_lfence();
+  return t;
+}
+
+// Smallest measured tsc_start/tsc_stop distance with nothing in between,
+// subtracted from every sample
+inline std::uint64_t tsc_overhead() {
+  static std::uint64_t const overhead = [] {
+    std::uint64_t best = UINT64_MAX;
+    for (int i = 0; i < 10000; ++i) {
+      std::uint64_t t0 = tsc_start();
+      std::uint64_t t1 = tsc_stop();
+      best = std::min(best, t1 - t0);
+    }
+    return best;
+  }();
+  return overhead;
+}
+
+// TSC ticks per nanosecond, measured against steady_clock
+inline double tsc_per_ns() {
+  static double const rate = [] {
+    using clock = std::chrono::steady_clock;
+    auto c0 = clock::now();
+    std::uint64_t t0 = tsc_start();
+    while (clock::now() - c0 < std::chrono::milliseconds(20)) {
+    }
+    auto c1 = clock::now();
+    std::uint64_t t1 = tsc_stop();
+    auto ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(c1 - c0).count();
+    return static_cast<double>(t1 - t0) / static_cast<double>(ns);
+  }();
+  return rate;
+}
+
+// Evicts [ptr, ptr + bytes) from every cache level
+inline void flush_cache(void const* ptr, std::size_t bytes) {
+  auto const* p = static_cast<char const*>(ptr);
+  for (std::size_t i = 0; i < bytes; i += 64) {
+    _mm_clflush(p + i);
+  }
+  if (bytes != 0) {
+    _mm_clflush(p + bytes - 1);
+  }
+  _mm_mfence();
+}
+
+// Per-call samples in TSC ticks, overhead already subtracted
+struct latency_stats {
+  std::vector<std::uint64_t> samples;
+
+  void add(std::uint64_t t0, std::uint64_t t1) {
+    std::uint64_t dt = t1 - t0;
+    std::uint64_t overhead = tsc_overhead();
+    samples.push_back(dt > overhead ? dt - overhead : 0);
+  }
+
+  // q in [0, 1], in nanoseconds; samples must be sorted
+  double percentile(double q) const {
+    auto n = samples.size();
+    auto i =
+        std::min(n - 1, static_cast<std::size_t>(q * static_cast<double>(n)));
+    return static_cast<double>(samples[i]) / tsc_per_ns();
+  }
+
+  // Percentiles and a linear histogram between the minimum and p99.9 are
+  // stored as user counters, so they end up in the JSON output
+  template <typename Counters> void report(Counters& counters) {
+    if (samples.empty()) {
+      return;
+    }
+    std::sort(samples.begin(), samples.end());
+    counters["p0"] = percentile(0);
+    counters["p10"] = percentile(0.1);
+    counters["p50"] = percentile(0.5);
+    counters["p90"] = percentile(0.9);
+    counters["p99"] = percentile(0.99);
+    counters["p99.9"] = percentile(0.999);
+    counters["max"] = percentile(1);
+    counters["tsc_overhead"] = static_cast<double>(tsc_overhead());
+
+    double lo = percentile(0);
+    double width = std::max((percentile(0.999) - lo) / LatencyBuckets, 1e-3);
+    std::uint64_t hist[LatencyBuckets] = {};
+    for (auto s : samples) {
+      double ns = static_cast<double>(s) / tsc_per_ns();
+      auto b = static_cast<int>((ns - lo) / width);
+      ++hist[std::min(b, LatencyBuckets - 1)];
+    }
+    counters["hist_lo"] = lo;
+    counters["hist_width"] = width;
+    for (int b = 0; b < LatencyBuckets; ++b) {
+      char name[] = "hist_00";
+      name[5] = static_cast<char>('0' + b / 10);
+      name[6] = static_cast<char>('0' + b % 10);
+      counters[name] = static_cast<double>(hist[b]);
+    }
+  }
+};
+#endif
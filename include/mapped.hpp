@@ -0,0 +1,256 @@
+#ifndef INCLUDE_MAPPED
+#define INCLUDE_MAPPED
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "simd.hpp"
+
+// On-disk matrix container:
+// | mapped_header | zero padding | row-major data |
+//                                ^ data_offset, multiple of header.alignment
+// Rows are row_stride elements apart; row_stride == n_cols means the data is
+// densely packed and can be fed to the kernels straight from the mapping.
+
+enum class dtype : std::uint32_t { float32 = 0, float64 = 1 };
+
+template <typename T> constexpr dtype dtype_of();
+template <> constexpr dtype dtype_of<f32>() { return dtype::float32; }
+template <> constexpr dtype dtype_of<f64>() { return dtype::float64; }
+
+constexpr char MappedMagic[8] = {'M', 'A', 'T', 'V', 'E', 'C', '\0', '\0'};
+constexpr std::uint32_t MappedVersion = 1;
+constexpr std::uint64_t MappedAlignment = 64;
+
+struct mapped_header {
+  char magic[8];
+  std::uint32_t version;
+  dtype type;
+  std::uint64_t n_rows;
+  std::uint64_t n_cols;
+  std::uint64_t row_stride; // in elements
+  std::uint64_t alignment;  // in bytes
+  std::uint64_t data_offset;
+};
+static_assert(sizeof(mapped_header) <= MappedAlignment);
+
+template <typename T> class mapped_matrix {
+public:
+  // Maps an existing file read-only
+  static mapped_matrix open(std::string const& path) {
+    mapped_matrix m;
+    m.fd_ = ::open(path.c_str(), O_RDONLY);
+    if (m.fd_ < 0) {
+      throw_errno("open " + path);
+    }
+    struct stat st {};
+    if (::fstat(m.fd_, &st) != 0) {
+      throw_errno("fstat " + path);
+    }
+    m.size_ = static_cast<std::size_t>(st.st_size);
+    if (m.size_ < sizeof(mapped_header)) {
+      throw std::runtime_error(path + ": truncated header");
+    }
+    m.map(PROT_READ);
+
+    mapped_header const& h = m.header();
+    if (std::memcmp(h.magic, MappedMagic, sizeof(MappedMagic)) != 0 or
+        h.version != MappedVersion) {
+      throw std::runtime_error(path + ": not a matvec matrix file");
+    }
+    if (h.type != dtype_of<T>()) {
+      throw std::runtime_error(path + ": element type mismatch");
+    }
+    if (not valid_layout(h, m.size_)) {
+      throw std::runtime_error(path + ": inconsistent header");
+    }
+    return m;
+  }
+
+  // Creates (or truncates) a file sized for an n_rows×n_cols matrix and maps
+  // it read-write, so it can be filled in place
+  static mapped_matrix create(
+      std::string const& path,
+      std::uint64_t n_rows,
+      std::uint64_t n_cols,
+      std::uint64_t row_stride = 0) {
+    row_stride = std::max(row_stride, n_cols);
+
+    mapped_header h{};
+    std::memcpy(h.magic, MappedMagic, sizeof(MappedMagic));
+    h.version = MappedVersion;
+    h.type = dtype_of<T>();
+    h.n_rows = n_rows;
+    h.n_cols = n_cols;
+    h.row_stride = row_stride;
+    h.alignment = MappedAlignment;
+    h.data_offset = MappedAlignment;
+
+    mapped_matrix m;
+    m.fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m.fd_ < 0) {
+      throw_errno("open " + path);
+    }
+    m.size_ = h.data_offset + n_rows * row_stride * sizeof(T);
+    if (::ftruncate(m.fd_, static_cast<off_t>(m.size_)) != 0) {
+      throw_errno("ftruncate " + path);
+    }
+    m.map(PROT_READ | PROT_WRITE);
+    std::memcpy(m.base_, &h, sizeof(h));
+    return m;
+  }
+
+  mapped_matrix(mapped_matrix&& other) noexcept
+      : fd_{other.fd_}, base_{other.base_}, size_{other.size_} {
+    other.fd_ = -1;
+    other.base_ = nullptr;
+  }
+  mapped_matrix& operator=(mapped_matrix&& other) noexcept {
+    std::swap(fd_, other.fd_);
+    std::swap(base_, other.base_);
+    std::swap(size_, other.size_);
+    return *this;
+  }
+  mapped_matrix(mapped_matrix const&) = delete;
+  mapped_matrix& operator=(mapped_matrix const&) = delete;
+
+  ~mapped_matrix() {
+    if (base_ != nullptr) {
+      ::munmap(base_, size_);
+    }
+    if (fd_ >= 0) {
+      ::close(fd_);
+    }
+  }
+
+  mapped_header const& header() const {
+    return *static_cast<mapped_header const*>(base_);
+  }
+  std::size_t rows() const { return header().n_rows; }
+  std::size_t cols() const { return header().n_cols; }
+  std::size_t stride() const { return header().row_stride; }
+  bool dense() const { return stride() == cols(); }
+  int fd() const { return fd_; }
+
+  // Flushes written data to disk
+  void sync() const {
+    if (::msync(base_, size_, MS_SYNC) != 0) {
+      throw_errno("msync");
+    }
+  }
+
+  T const* data() const {
+    return reinterpret_cast<T const*>(
+        static_cast<char const*>(base_) + header().data_offset);
+  }
+  T* data() {
+    return reinterpret_cast<T*>(
+        static_cast<char*>(base_) + header().data_offset);
+  }
+  T const* row(std::size_t i) const { return data() + i * stride(); }
+  T* row(std::size_t i) { return data() + i * stride(); }
+
+  // Page-aligned madvise over the byte range covering rows [first, last).
+  // MADV_DONTNEED stops at the page holding row `last` instead, which may
+  // still be needed for the rows that follow
+  void advise(std::size_t first, std::size_t last, int advice) const {
+    if (first >= last) {
+      return;
+    }
+    static std::uintptr_t const page =
+        static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+    auto begin = reinterpret_cast<std::uintptr_t>(row(first));
+    auto end = reinterpret_cast<std::uintptr_t>(row(last));
+    begin &= ~(page - 1);
+    if (advice == MADV_DONTNEED) {
+      end &= ~(page - 1);
+      if (end <= begin) {
+        return;
+      }
+    }
+    ::madvise(reinterpret_cast<void*>(begin), end - begin, advice);
+  }
+
+private:
+  mapped_matrix() = default;
+
+  // Alignment a power of two no smaller than MappedAlignment, data past the
+  // header and every row inside a file of file_size bytes. Written with
+  // divisions so that a corrupt header cannot overflow its way through
+  static bool valid_layout(mapped_header const& h, std::size_t file_size) {
+    if (h.alignment < MappedAlignment or
+        (h.alignment & (h.alignment - 1)) != 0) {
+      return false;
+    }
+    if (h.data_offset % h.alignment != 0 or
+        h.data_offset < sizeof(mapped_header) or h.data_offset > file_size) {
+      return false;
+    }
+    if (h.row_stride < h.n_cols) {
+      return false;
+    }
+    std::uint64_t elems = (file_size - h.data_offset) / sizeof(T);
+    return h.row_stride == 0 or h.n_rows <= elems / h.row_stride;
+  }
+
+  void map(int prot) {
+    base_ = ::mmap(nullptr, size_, prot, MAP_SHARED, fd_, 0);
+    if (base_ == MAP_FAILED) {
+      base_ = nullptr;
+      throw_errno("mmap");
+    }
+  }
+
+  int fd_ = -1;
+  void* base_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+// Out-of-core matvec over a mapped matrix, chunk_bytes of rows at a time.
+// While a chunk is being multiplied, readahead of the next one is already in
+// flight (MADV_WILLNEED), and pages of finished chunks are dropped from the
+// mapping so the resident set stays around two chunks.
+template <int n_cols, typename T>
+void stream_prod(
+    mapped_matrix<T> const& mat,
+    T const* in_data,
+    T* out_data,
+    std::size_t chunk_bytes = std::size_t{64} << 20U) {
+  if (mat.cols() != n_cols) {
+    throw std::invalid_argument("stream_prod: column count mismatch");
+  }
+  std::size_t const n_rows = mat.rows();
+  std::size_t const chunk_rows =
+      std::max<std::size_t>(1, chunk_bytes / (mat.stride() * sizeof(T)));
+
+  mat.advise(0, n_rows, MADV_SEQUENTIAL);
+  mat.advise(0, std::min(chunk_rows, n_rows), MADV_WILLNEED);
+
+  for (std::size_t first = 0; first < n_rows; first += chunk_rows) {
+    std::size_t const last = std::min(first + chunk_rows, n_rows);
+    mat.advise(last, std::min(last + chunk_rows, n_rows), MADV_WILLNEED);
+
+    if (mat.dense()) {
+      matvec_simd_n(
+          mat.row(first),
+          in_data,
+          out_data + first,
+          last - first,
+          int_constant<n_cols>{});
+    } else {
+      for (std::size_t i = first; i < last; ++i) {
+        matvec_simd<1>(
+            mat.row(i), in_data, out_data + i, int_constant<n_cols>{});
+      }
+    }
+    mat.advise(first, last, MADV_DONTNEED);
+  }
+}
+#endif
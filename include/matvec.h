@@ -0,0 +1,74 @@
+#ifndef INCLUDE_MATVEC_H
+#define INCLUDE_MATVEC_H
+/* C interface of libmatvec, the prebuilt matvec_simd kernels.
+ * All matrices are row-major and densely packed: row i starts at
+ * mat + i * n_cols. n_cols must be 2, 4 or 8. Row counts up to
+ * MATVEC_MAX_TABLE_ROWS resolve to a dedicated kernel through a table,
+ * larger ones run blocks of that size followed by the remainder. */
+#include <stddef.h>
+
+#if defined(_WIN32)
+#if defined(MATVEC_BUILD)
+#define MATVEC_API __declspec(dllexport)
+#else
+#define MATVEC_API
+#endif
+#else
+#define MATVEC_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MATVEC_MAX_TABLE_ROWS 128
+
+/* Same values as the dtype field of the on-disk format in mapped.hpp */
+typedef enum matvec_dtype { MATVEC_F32 = 0, MATVEC_F64 = 1 } matvec_dtype;
+
+typedef enum matvec_status {
+  MATVEC_OK = 0,
+  MATVEC_INVALID_TYPE = 1,
+  MATVEC_INVALID_COLS = 2
+} matvec_status;
+
+typedef void (*matvec_kernel_f32)(float const*, float const*, float*);
+typedef void (*matvec_kernel_f64)(double const*, double const*, double*);
+
+/* out[0, n_rows) = mat * in, with mat, in and out of element type `type` */
+MATVEC_API matvec_status matvec_prod(
+    matvec_dtype type,
+    size_t n_rows,
+    size_t n_cols,
+    void const* mat,
+    void const* in,
+    void* out);
+
+MATVEC_API matvec_status matvec_prod_f32(
+    size_t n_rows,
+    size_t n_cols,
+    float const* mat,
+    float const* in,
+    float* out);
+MATVEC_API matvec_status matvec_prod_f64(
+    size_t n_rows,
+    size_t n_cols,
+    double const* mat,
+    double const* in,
+    double* out);
+
+/* Kernel for a fixed shape, for callers that multiply the same shape many
+ * times. Returns NULL if n_cols is unsupported or
+ * n_rows > MATVEC_MAX_TABLE_ROWS */
+MATVEC_API matvec_kernel_f32
+matvec_get_kernel_f32(size_t n_rows, size_t n_cols);
+MATVEC_API matvec_kernel_f64
+matvec_get_kernel_f64(size_t n_rows, size_t n_cols);
+
+/* Version of the interface, bumped on incompatible changes */
+MATVEC_API int matvec_abi_version(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,121 @@
+#ifndef INCLUDE_MIXED
+#define INCLUDE_MIXED
+#include <type_traits>
+
+#include "simd.hpp"
+
+// f32 matrix and vector, with products and sums computed in f64. The
+// product of two f32 values is exact in f64, so the only rounding left is
+// that of the f64 sums and of the final store, at f32 memory traffic.
+// Out is f32 or f64.
+
+// a0 a1 a2 a3 => a0..4
+INLINE f64 mixed_sum_1(__m256d a) {
+  __m128d s = _mm256_extractf128_pd(a, 1) + _mm256_castpd256_pd128(a);
+  return s[0] + s[1];
+}
+
+INLINE void mixed_store_4(f64* out_data, __m256d sums) {
+  _mm256_storeu_pd(out_data, sums);
+}
+INLINE void mixed_store_4(f32* out_data, __m256d sums) {
+  _mm_storeu_ps(out_data, _mm256_cvtpd_ps(sums));
+}
+
+// [f32 → f64][n_rows][8]
+template <int n_rows, typename Out>
+INLINE void matvec_mixed_inline(
+    f32 const* mat, f32 const* in_data, Out* out_data, int_constant<8>) {
+  __m256d in_1;
+  __m256d in_2;
+  in_1 = _mm256_cvtps_pd(_mm_loadu_ps(in_data));
+  in_2 = _mm256_cvtps_pd(_mm_loadu_ps(in_data + 4));
+
+  // a0 + a4 | a1 + a5 | a2 + a6 | a3 + a7
+  auto row = [&](int i) {
+    __m256d p = _mm256_cvtps_pd(_mm_loadu_ps(mat + 8 * i)) * in_1;
+    return _mm256_fmadd_pd(
+        _mm256_cvtps_pd(_mm_loadu_ps(mat + 8 * i + 4)), in_2, p);
+  };
+
+  // 4 rows at a time, at row 4xi
+  auto batch_4 = [&](int i) {
+    mixed_store_4(
+        out_data + 4 * i,
+        transpose_sum_4(
+            row(4 * i), row(4 * i + 1), row(4 * i + 2), row(4 * i + 3)));
+  };
+  auto batch_1 = [&](int i) {
+    out_data[i] = static_cast<Out>(mixed_sum_1(row(i)));
+  };
+  unroll<UnrollNum, 0, n_rows / 4>(batch_4);
+
+  unroll<1, n_rows / 4 * 4, n_rows % 4>(batch_1);
+}
+
+// [f32 → f64][n_rows][4]
+template <int n_rows, typename Out>
+INLINE void matvec_mixed_inline(
+    f32 const* mat, f32 const* in_data, Out* out_data, int_constant<4>) {
+  __m256d in;
+  in = _mm256_cvtps_pd(_mm_loadu_ps(in_data));
+
+  // a0 a1 a2 a3
+  auto row = [&](int i) {
+    return _mm256_cvtps_pd(_mm_loadu_ps(mat + 4 * i)) * in;
+  };
+
+  // 4 rows at a time, at row 4xi
+  auto batch_4 = [&](int i) {
+    mixed_store_4(
+        out_data + 4 * i,
+        transpose_sum_4(
+            row(4 * i), row(4 * i + 1), row(4 * i + 2), row(4 * i + 3)));
+  };
+  auto batch_1 = [&](int i) {
+    out_data[i] = static_cast<Out>(mixed_sum_1(row(i)));
+  };
+  unroll<UnrollNum, 0, n_rows / 4>(batch_4);
+
+  unroll<1, n_rows / 4 * 4, n_rows % 4>(batch_1);
+}
+
+// [f32 → f64][n_rows][2]
+template <int n_rows, typename Out>
+INLINE void matvec_mixed_inline(
+    f32 const* mat, f32 const* in_data, Out* out_data, int_constant<2>) {
+  __m256d in;
+  __m256d mat_row_12;
+  __m256d mat_row_34;
+  in = _mm256_setr_pd(in_data[0], in_data[1], in_data[0], in_data[1]);
+
+  // 4 rows at a time, at row 4xi
+  auto batch_4 = [&](int i) {
+    // a0 a1 b0 b1
+    mat_row_12 = _mm256_cvtps_pd(_mm_loadu_ps(mat + 8 * i)) * in;
+    // c0 c1 d0 d1
+    mat_row_34 = _mm256_cvtps_pd(_mm_loadu_ps(mat + 8 * i + 4)) * in;
+
+    // a0 + a1 | c0 + c1 | b0 + b1 | d0 + d1
+    mat_row_12 = _mm256_hadd_pd(mat_row_12, mat_row_34);
+    // a0 + a1 | b0 + b1 | c0 + c1 | d0 + d1
+    mat_row_12 = _mm256_permute4x64_pd(mat_row_12, 0xD8);
+    mixed_store_4(out_data + 4 * i, mat_row_12);
+  };
+  auto batch_1 = [&](int i) {
+    out_data[i] = static_cast<Out>(
+        static_cast<f64>(in_data[0]) * static_cast<f64>(mat[2 * i]) +
+        static_cast<f64>(in_data[1]) * static_cast<f64>(mat[2 * i + 1]));
+  };
+  unroll<UnrollNum, 0, n_rows / 4>(batch_4);
+
+  unroll<1, n_rows / 4 * 4, n_rows % 4>(batch_1);
+}
+
+template <int n_rows, typename Out, int n_cols>
+NOINLINE void matvec_mixed(
+    f32 const* mat, f32 const* in_data, Out* out_data, int_constant<n_cols>) {
+  static_assert(std::is_same_v<Out, f32> or std::is_same_v<Out, f64>);
+  matvec_mixed_inline<n_rows>(mat, in_data, out_data, int_constant<n_cols>{});
+}
+#endif
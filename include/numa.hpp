@@ -0,0 +1,387 @@
+#ifndef INCLUDE_NUMA
+#define INCLUDE_NUMA
+#include <algorithm>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "arena.hpp"
+#include "simd.hpp"
+
+// "0-3,8,10-11" => 0 1 2 3 8 10 11, the sysfs list format
+inline std::vector<int> parse_id_list(std::string const& list) {
+  std::vector<int> ids;
+  std::size_t pos = 0;
+  while (pos < list.size()) {
+    std::size_t end = list.find(',', pos);
+    if (end == std::string::npos) {
+      end = list.size();
+    }
+    std::string item = list.substr(pos, end - pos);
+    pos = end + 1;
+    if (item.find_first_of("0123456789") == std::string::npos) {
+      continue;
+    }
+    std::size_t dash = item.find('-');
+    int first = std::stoi(item.substr(0, dash));
+    int last = dash == std::string::npos ? first
+                                         : std::stoi(item.substr(dash + 1));
+    for (int id = first; id <= last; ++id) {
+      ids.push_back(id);
+    }
+  }
+  return ids;
+}
+
+// CPUs the calling thread may run on
+inline std::vector<int> allowed_cpus() {
+  std::vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (::sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (std::size_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus.push_back(static_cast<int>(cpu));
+      }
+    }
+  }
+  if (cpus.empty()) {
+    for (unsigned cpu = 0; cpu < std::thread::hardware_concurrency(); ++cpu) {
+      cpus.push_back(static_cast<int>(cpu));
+    }
+  }
+  return cpus;
+}
+
+// Nodes with at least one usable CPU, read from sysfs. Without NUMA support
+// (or without sysfs) this is a single node holding every allowed CPU
+struct numa_topology {
+  std::vector<int> nodes;              // kernel node ids
+  std::vector<std::vector<int> > cpus; // [node index][i]
+
+  std::size_t size() const { return nodes.size(); }
+
+  static numa_topology detect() {
+    numa_topology topo;
+    std::vector<int> allowed = allowed_cpus();
+
+    std::string line;
+    std::ifstream online("/sys/devices/system/node/online");
+    if (std::getline(online, line)) {
+      for (int node : parse_id_list(line)) {
+        std::ifstream f(
+            "/sys/devices/system/node/node" + std::to_string(node) +
+            "/cpulist");
+        std::vector<int> cpus;
+        if (std::getline(f, line)) {
+          for (int cpu : parse_id_list(line)) {
+            if (std::find(allowed.begin(), allowed.end(), cpu) !=
+                allowed.end()) {
+              cpus.push_back(cpu);
+            }
+          }
+        }
+        // Memory-only nodes and nodes outside our cpuset get no workers
+        if (not cpus.empty()) {
+          topo.nodes.push_back(node);
+          topo.cpus.push_back(std::move(cpus));
+        }
+      }
+    }
+    if (topo.nodes.empty()) {
+      topo.nodes = {0};
+      topo.cpus = {std::move(allowed)};
+    }
+    return topo;
+  }
+};
+
+// Restricts the calling thread to `cpus`; best effort
+inline bool pin_to_cpus(std::vector<int> const& cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int id : cpus) {
+    auto cpu = static_cast<std::size_t>(id);
+    if (id >= 0 and cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &set);
+    }
+  }
+  return ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set) == 0;
+}
+
+// Places the pages of [addr, addr + bytes) on `node` when they are first
+// touched. Raw syscall so that libnuma is not needed; false if the kernel
+// lacks NUMA support or the range cannot be bound
+inline bool bind_to_node(void* addr, std::size_t bytes, int node) {
+#ifdef SYS_mbind
+  constexpr int MpolBind = 2; // MPOL_BIND in <numaif.h>
+  constexpr std::size_t Bits = sizeof(unsigned long) * CHAR_BIT;
+  std::vector<unsigned long> mask(static_cast<std::size_t>(node) / Bits + 1);
+  mask.back() = 1UL << (static_cast<std::size_t>(node) % Bits);
+  return ::syscall(
+             SYS_mbind,
+             addr,
+             bytes,
+             MpolBind,
+             mask.data(),
+             mask.size() * Bits + 1,
+             0) == 0;
+#else
+  unused(addr, bytes, node);
+  return false;
+#endif
+}
+
+enum class numa_placement {
+  // Rows of each node are bound to it with mbind when possible, then first
+  // touched by the workers that own them
+  local,
+  // Every page first touched by the constructing thread, as a plain
+  // allocation would be; the baseline
+  caller,
+};
+
+// Tall [n_rows][n_cols] matrix split across NUMA nodes, with a pool of
+// workers pinned per node. Each worker owns a fixed range of rows: it first
+// touches them at construction and multiplies the same range on every call,
+// so with local placement rows are only ever read by cores of the node
+// holding them. Node boundaries fall on page boundaries.
+// On a single node machine this is a plain parallel matvec.
+template <typename T, int n_cols> class numa_matvec {
+public:
+  explicit numa_matvec(
+      std::size_t n_rows,
+      numa_placement placement = numa_placement::local,
+      numa_topology topo = numa_topology::detect(),
+      std::size_t threads_per_node = 0)
+      : n_rows_{n_rows}, topo_{std::move(topo)} {
+    std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    bytes_ = round_up(std::max<std::size_t>(1, n_rows * RowBytes), page);
+    void* p = ::mmap(
+        nullptr,
+        bytes_,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS,
+        -1,
+        0);
+    if (p == MAP_FAILED) {
+      throw_errno("mmap");
+    }
+    data_ = static_cast<T*>(p);
+
+    split_rows(page, threads_per_node);
+
+    // Binding only matters with several nodes; first touch from the pinned
+    // workers already gives the same placement when mbind is unavailable
+    if (placement == numa_placement::local and topo_.size() > 1) {
+      bound_ = true;
+      for (std::size_t k = 0; k < topo_.size(); ++k) {
+        std::size_t first = node_rows_[k];
+        std::size_t last = node_rows_[k + 1];
+        if (first != last) {
+          bound_ = bind_to_node(
+                       data_ + first * n_cols,
+                       (last - first) * RowBytes,
+                       topo_.nodes[k]) and
+                   bound_;
+        }
+      }
+    }
+    if (placement == numa_placement::caller) {
+      std::memset(data_, 0, n_rows * RowBytes);
+    }
+
+    for (std::size_t id = 0; id < workers_.size(); ++id) {
+      threads_.emplace_back([this, id] { worker_loop(id); });
+    }
+    if (placement == numa_placement::local) {
+      launch(task::touch, AllNodes, nullptr, nullptr);
+    }
+  }
+
+  numa_matvec(numa_matvec const&) = delete;
+  numa_matvec& operator=(numa_matvec const&) = delete;
+
+  ~numa_matvec() {
+    {
+      std::lock_guard<std::mutex> guard{lock_};
+      stop_ = true;
+    }
+    start_.notify_all();
+    for (auto& t : threads_) {
+      t.join();
+    }
+    ::munmap(data_, bytes_);
+  }
+
+  // Row-major storage, zero initialized. Writing it does not move pages
+  T* data() { return data_; }
+  T const* data() const { return data_; }
+  std::size_t rows() const { return n_rows_; }
+
+  numa_topology const& topology() const { return topo_; }
+  std::size_t threads() const { return workers_.size(); }
+  // Whether every node's rows were bound with mbind
+  bool bound() const { return bound_; }
+
+  // Rows [first, last) of node index k
+  std::pair<std::size_t, std::size_t> node_rows(std::size_t k) const {
+    return {node_rows_[k], node_rows_[k + 1]};
+  }
+
+  // out[0, n_rows) = mat × in, with all workers
+  void prod(T const* in, T* out) { launch(task::prod, AllNodes, in, out); }
+
+  // out[node_rows(k)] = rows of node k × in, with that node's workers only
+  void prod_node(std::size_t k, T const* in, T* out) {
+    launch(task::prod, k, in, out);
+  }
+
+private:
+  static constexpr std::size_t RowBytes = n_cols * sizeof(T);
+  static constexpr std::size_t AllNodes = ~std::size_t{0};
+
+  enum class task { touch, prod };
+
+  struct worker {
+    std::size_t node;
+    std::size_t first;
+    std::size_t last;
+  };
+
+  // Rows are shared between nodes in proportion to their workers, rounded
+  // to whole pages, then evenly between the workers of each node
+  void split_rows(std::size_t page, std::size_t threads_per_node) {
+    std::size_t n_nodes = topo_.size();
+    std::vector<std::size_t> n_workers(n_nodes);
+    std::size_t total = 0;
+    for (std::size_t k = 0; k < n_nodes; ++k) {
+      n_workers[k] =
+          threads_per_node != 0 ? threads_per_node : topo_.cpus[k].size();
+      total += n_workers[k];
+    }
+
+    std::size_t page_rows = std::max<std::size_t>(1, page / RowBytes);
+    node_rows_.assign(1, 0);
+    std::size_t acc = 0;
+    for (std::size_t k = 0; k < n_nodes; ++k) {
+      acc += n_workers[k];
+      std::size_t last = k + 1 == n_nodes
+                             ? n_rows_
+                             : std::min(
+                                   n_rows_,
+                                   round_up_rows(
+                                       n_rows_ * acc / total, page_rows));
+      node_rows_.push_back(std::max(last, node_rows_.back()));
+    }
+
+    for (std::size_t k = 0; k < n_nodes; ++k) {
+      std::size_t first = node_rows_[k];
+      std::size_t count = node_rows_[k + 1] - first;
+      for (std::size_t w = 0; w < n_workers[k]; ++w) {
+        workers_.push_back(
+            {k,
+             first + count * w / n_workers[k],
+             first + count * (w + 1) / n_workers[k]});
+      }
+    }
+  }
+
+  static std::size_t round_up_rows(std::size_t n, std::size_t multiple) {
+    return (n + multiple - 1) / multiple * multiple;
+  }
+
+  void launch(task kind, std::size_t node, T const* in, T* out) {
+    {
+      std::lock_guard<std::mutex> guard{lock_};
+      kind_ = kind;
+      node_ = node;
+      in_ = in;
+      out_ = out;
+      remaining_ = workers_.size();
+      ++generation_;
+    }
+    start_.notify_all();
+
+    std::unique_lock<std::mutex> guard{lock_};
+    finished_.wait(guard, [this] { return remaining_ == 0; });
+  }
+
+  void worker_loop(std::size_t id) {
+    worker const w = workers_[id];
+    pin_to_cpus(topo_.cpus[w.node]);
+
+    std::uint64_t seen = 0;
+    while (true) {
+      task kind;
+      std::size_t node;
+      T const* in;
+      T* out;
+      {
+        std::unique_lock<std::mutex> guard{lock_};
+        start_.wait(guard, [&] { return stop_ or generation_ != seen; });
+        if (stop_) {
+          return;
+        }
+        seen = generation_;
+        kind = kind_;
+        node = node_;
+        in = in_;
+        out = out_;
+      }
+
+      if ((node == AllNodes or node == w.node) and w.first != w.last) {
+        if (kind == task::touch) {
+          std::memset(
+              data_ + w.first * n_cols, 0, (w.last - w.first) * RowBytes);
+        } else {
+          matvec_simd_n(
+              data_ + w.first * n_cols,
+              in,
+              out + w.first,
+              w.last - w.first,
+              int_constant<n_cols>{});
+        }
+      }
+
+      std::lock_guard<std::mutex> guard{lock_};
+      if (--remaining_ == 0) {
+        finished_.notify_one();
+      }
+    }
+  }
+
+  std::size_t n_rows_;
+  numa_topology topo_;
+  std::size_t bytes_ = 0;
+  T* data_ = nullptr;
+  bool bound_ = false;
+
+  std::vector<std::size_t> node_rows_; // [n_nodes + 1]
+  std::vector<worker> workers_;
+  std::vector<std::thread> threads_;
+
+  std::mutex lock_;
+  std::condition_variable start_;
+  std::condition_variable finished_;
+  std::uint64_t generation_ = 0;
+  bool stop_ = false;
+  task kind_ = task::prod;
+  std::size_t node_ = AllNodes;
+  T const* in_ = nullptr;
+  T* out_ = nullptr;
+  std::size_t remaining_ = 0;
+};
+#endif
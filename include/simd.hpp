@@ -1,6 +1,10 @@
 #ifndef INCLUDE_SIMD
 #define INCLUDE_SIMD
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <x86intrin.h>
+#include "instrument.hpp"
 #include "utility.hpp"
 
 // Let the compiler unroll the loops for now
@@ -8,7 +12,7 @@ constexpr int UnrollNum = 1;
 
 // [f32][n_rows][8]
 template <int n_rows>
-NOINLINE void matvec_simd(
+INLINE void matvec_simd_inline(
     f32 const* mat, f32 const* in_data, f32* out_data, int_constant<8>) {
   static_assert(sizeof(f32) * 8 % 32 == 0);
   __m256 in;
@@ -111,7 +115,7 @@ NOINLINE void matvec_simd(
 
 // [f32][n_rows][4]
 template <int n_rows>
-NOINLINE void matvec_simd(
+INLINE void matvec_simd_inline(
     f32 const* mat, f32 const* in_data, f32* out_data, int_constant<4>) {
   __m256 in;
   __m256 mat_row_1;
@@ -168,7 +172,7 @@ NOINLINE void matvec_simd(
 
 // [f32][n_rows][2]
 template <int n_rows>
-NOINLINE void matvec_simd(
+INLINE void matvec_simd_inline(
     f32 const* mat, f32 const* in_data, f32* out_data, int_constant<2>) {
   __m256 in;
   __m256 mat_row_1;
@@ -247,7 +251,7 @@ NOINLINE void matvec_simd(
 
 // [f64][n_rows][8]
 template <int n_rows>
-NOINLINE void matvec_simd(
+INLINE void matvec_simd_inline(
     f64 const* mat, f64 const* in_data, f64* out_data, int_constant<8>) {
   static_assert(sizeof(f64) * 4 % 32 == 0);
   __m256d in_1;
@@ -307,7 +311,7 @@ NOINLINE void matvec_simd(
 
 // [f64][n_rows][4]
 template <int n_rows>
-NOINLINE void matvec_simd(
+INLINE void matvec_simd_inline(
     f64 const* mat, f64 const* in_data, f64* out_data, int_constant<4>) {
   static_assert(sizeof(f64) * 4 % 32 == 0);
   __m256d in;
@@ -346,7 +350,7 @@ NOINLINE void matvec_simd(
 
 // [f64][n_rows][2]
 template <int n_rows>
-NOINLINE void matvec_simd(
+INLINE void matvec_simd_inline(
     f64 const* mat, f64 const* in_data, f64* out_data, int_constant<2>) {
   static_assert(sizeof(f64) * 4 % 32 == 0);
   __m256d in;
@@ -416,4 +420,327 @@ NOINLINE void matvec_simd(
     batch_1(n_rows - 1);
   }
 }
+
+// Register-transpose variants of the kernels above. Instead of reducing each
+// row with horizontal adds, the products of a full register of rows are
+// transposed in registers and summed lane-wise, so every step ends with one
+// 256-bit store. Remaining rows go to the horizontal add kernel.
+
+// Shapes without a transpose variant
+template <int n_rows, typename T, int n_cols>
+INLINE void matvec_simd_transpose_inline(
+    T const* mat, T const* in_data, T* out_data, int_constant<n_cols>) {
+  matvec_simd_inline<n_rows>(mat, in_data, out_data, int_constant<n_cols>{});
+}
+
+// a, b, ..., h => a0..8 | b0..8 | ... | h0..8. The rows are taken by value
+// so that they stay in registers at any optimization level
+INLINE __m256 transpose_sum_8(
+    __m256 a, __m256 b, __m256 c, __m256 d, //
+    __m256 e, __m256 f, __m256 g, __m256 h) {
+  // a0 b0 a1 b1 | a4 b4 a5 b5 + a2 b2 a3 b3 | a6 b6 a7 b7 =>
+  // a02 b02 a13 b13 | a46 b46 a57 b57
+  __m256 s01 = _mm256_unpacklo_ps(a, b) + _mm256_unpackhi_ps(a, b);
+  __m256 s23 = _mm256_unpacklo_ps(c, d) + _mm256_unpackhi_ps(c, d);
+  __m256 s45 = _mm256_unpacklo_ps(e, f) + _mm256_unpackhi_ps(e, f);
+  __m256 s67 = _mm256_unpacklo_ps(g, h) + _mm256_unpackhi_ps(g, h);
+
+  // a02 b02 c02 d02 | a46 b46 c46 d46 + a13 b13 c13 d13 | a57 b57 c57 d57
+  // => a0..4 b0..4 c0..4 d0..4 | a4..8 b4..8 c4..8 d4..8
+  __m256 lo =
+      _mm256_shuffle_ps(s01, s23, 0x44) + _mm256_shuffle_ps(s01, s23, 0xEE);
+  // e0..4 f0..4 g0..4 h0..4 | e4..8 f4..8 g4..8 h4..8
+  __m256 hi =
+      _mm256_shuffle_ps(s45, s67, 0x44) + _mm256_shuffle_ps(s45, s67, 0xEE);
+
+  // a0..4 b0..4 c0..4 d0..4 | e0..4 f0..4 g0..4 h0..4 +
+  // a4..8 b4..8 c4..8 d4..8 | e4..8 f4..8 g4..8 h4..8
+  return _mm256_permute2f128_ps(lo, hi, 0x20) +
+         _mm256_permute2f128_ps(lo, hi, 0x31);
+}
+
+// a, b, c, d => a0..4 | b0..4 | c0..4 | d0..4
+INLINE __m256d transpose_sum_4(__m256d a, __m256d b, __m256d c, __m256d d) {
+  // a0 b0 | a2 b2 + a1 b1 | a3 b3 => a01 b01 | a23 b23
+  __m256d s01 = _mm256_unpacklo_pd(a, b) + _mm256_unpackhi_pd(a, b);
+  // c01 d01 | c23 d23
+  __m256d s23 = _mm256_unpacklo_pd(c, d) + _mm256_unpackhi_pd(c, d);
+
+  // a01 b01 | c01 d01 + a23 b23 | c23 d23
+  return _mm256_permute2f128_pd(s01, s23, 0x20) +
+         _mm256_permute2f128_pd(s01, s23, 0x31);
+}
+
+// [f32][n_rows][8]
+template <int n_rows>
+INLINE void matvec_simd_transpose_inline(
+    f32 const* mat, f32 const* in_data, f32* out_data, int_constant<8>) {
+  __m256 in;
+  in = _mm256_loadu_ps(in_data);
+
+  // 8 rows at a time, at row 8xi
+  auto batch_8 = [&](int i) {
+    auto row = [&](int k) {
+      return _mm256_loadu_ps(mat + 64 * i + 8 * k) * in;
+    };
+    _mm256_storeu_ps(
+        out_data + 8 * i,
+        transpose_sum_8(
+            row(0), row(1), row(2), row(3), row(4), row(5), row(6), row(7)));
+  };
+  unroll<UnrollNum, 0, n_rows / 8>(batch_8);
+
+  constexpr int n_done = n_rows / 8 * 8;
+  matvec_simd_inline<n_rows % 8>(
+      mat + 8 * n_done, in_data, out_data + n_done, int_constant<8>{});
+}
+
+// [f64][n_rows][4]
+template <int n_rows>
+INLINE void matvec_simd_transpose_inline(
+    f64 const* mat, f64 const* in_data, f64* out_data, int_constant<4>) {
+  __m256d in;
+  in = _mm256_loadu_pd(in_data);
+
+  // 4 rows at a time, at row 4xi
+  auto batch_4 = [&](int i) {
+    auto row = [&](int k) {
+      return _mm256_loadu_pd(mat + 16 * i + 4 * k) * in;
+    };
+    _mm256_storeu_pd(
+        out_data + 4 * i, transpose_sum_4(row(0), row(1), row(2), row(3)));
+  };
+  unroll<UnrollNum, 0, n_rows / 4>(batch_4);
+
+  constexpr int n_done = n_rows / 4 * 4;
+  matvec_simd_inline<n_rows % 4>(
+      mat + 4 * n_done, in_data, out_data + n_done, int_constant<4>{});
+}
+
+// Whether [T][n_rows][n_cols] runs the transpose kernel, chosen per shape
+// from the bm_hadd/bm_trsp timings of the single (1 to 16 rows) and multi
+// (17 to 128 rows) benchmarks. Below one full step both variants run the same
+// code. f64×4 keeps the horizontal adds: the transpose kernel is within noise
+// of them for every row count
+template <typename T, int n_cols> constexpr bool use_transpose_kernel(int) {
+  return false;
+}
+// 8% to 22% faster from 8 rows on
+template <> constexpr bool use_transpose_kernel<f32, 8>(int n_rows) {
+  return n_rows >= 8;
+}
+
+// Kernel selected for the shape
+template <int n_rows, typename T, int n_cols>
+INLINE void matvec_simd_best_inline(
+    T const* mat, T const* in_data, T* out_data, int_constant<n_cols>) {
+  if constexpr (use_transpose_kernel<T, n_cols>(n_rows)) {
+    matvec_simd_transpose_inline<n_rows>(
+        mat, in_data, out_data, int_constant<n_cols>{});
+  } else {
+    matvec_simd_inline<n_rows>(mat, in_data, out_data, int_constant<n_cols>{});
+  }
+}
+
+// The kernels above are always inlined so that callers such as layer chains
+// can keep small results in registers; this is the out-of-line entry point
+template <int n_rows, typename T, int n_cols>
+NOINLINE void
+matvec_simd(T const* mat, T const* in_data, T* out_data, int_constant<n_cols>) {
+  matvec_simd_best_inline<n_rows>(
+      mat, in_data, out_data, int_constant<n_cols>{});
+}
+
+// Out-of-line entry points for a fixed reduction, to compare the two
+template <int n_rows, typename T, int n_cols>
+NOINLINE void matvec_simd_hadd(
+    T const* mat, T const* in_data, T* out_data, int_constant<n_cols>) {
+  matvec_simd_inline<n_rows>(mat, in_data, out_data, int_constant<n_cols>{});
+}
+template <int n_rows, typename T, int n_cols>
+NOINLINE void matvec_simd_transpose(
+    T const* mat, T const* in_data, T* out_data, int_constant<n_cols>) {
+  matvec_simd_transpose_inline<n_rows>(
+      mat, in_data, out_data, int_constant<n_cols>{});
+}
+
+// Largest row count with a dedicated kernel in the runtime dispatch table
+constexpr int MaxStaticRows = 128;
+
+template <typename T, int n_cols, std::size_t... Ns>
+constexpr auto make_matvec_table(std::index_sequence<Ns...>) {
+  using kernel_t = void (*)(T const*, T const*, T*, int_constant<n_cols>);
+  return std::array<kernel_t, sizeof...(Ns)>{
+      static_cast<kernel_t>(&matvec_simd<static_cast<int>(Ns)>)...};
+}
+
+// [T][n_rows][n_cols], n_rows only known at runtime
+// Runs blocks of MaxStaticRows rows, then dispatches the remainder to the
+// matching fixed size kernel
+template <typename T, int n_cols>
+void matvec_simd_n(
+    T const* mat,
+    T const* in_data,
+    T* out_data,
+    std::size_t n_rows,
+    int_constant<n_cols>) {
+  static constexpr auto table = make_matvec_table<T, n_cols>(
+      std::make_index_sequence<MaxStaticRows>());
+  MATVEC_PROFILE(T, n_rows, n_cols);
+
+  for (; n_rows >= MaxStaticRows; n_rows -= MaxStaticRows) {
+    matvec_simd<MaxStaticRows>(mat, in_data, out_data, int_constant<n_cols>{});
+    mat += MaxStaticRows * n_cols;
+    out_data += MaxStaticRows;
+  }
+  table[n_rows](mat, in_data, out_data, int_constant<n_cols>{});
+}
+
+// Vectors multiplied per pass by the multi-vector kernels
+constexpr int MultiVecBlock = 4;
+
+// [T][n_rows][n_cols] × n_vecs, generic version: one matvec per vector over
+// a block of rows that is still in L1 from the previous vector
+template <int n_vecs, typename T, int n_cols>
+INLINE void matvec_multi_block(
+    T const* mat,
+    T const* const* in_data,
+    T* const* out_data,
+    std::size_t n_rows,
+    int_constant<n_cols>) {
+  for (int v = 0; v < n_vecs; ++v) {
+    matvec_simd_n(
+        mat, in_data[v], out_data[v], n_rows, int_constant<n_cols>{});
+  }
+}
+
+// [f32][n_rows][8] × n_vecs
+// Rows are loaded once and reduced against every vector held in registers
+template <int n_vecs>
+INLINE void matvec_multi_block(
+    f32 const* mat,
+    f32 const* const* in_data,
+    f32* const* out_data,
+    std::size_t n_rows,
+    int_constant<8>) {
+  static_assert(n_vecs > 0);
+  __m256 in[static_cast<std::size_t>(n_vecs)];
+  __m256 mat_row_1;
+  __m256 mat_row_2;
+  __m256 mat_row_3;
+  __m256 mat_row_4;
+  __m256 a;
+  __m256 c;
+  __m128 f4;
+  for (int v = 0; v < n_vecs; ++v) {
+    in[v] = _mm256_loadu_ps(in_data[v]);
+  }
+
+  std::size_t i = 0;
+  for (; i + 4 <= n_rows; i += 4) {
+    mat_row_1 = _mm256_loadu_ps(mat + 8 * i);
+    mat_row_2 = _mm256_loadu_ps(mat + 8 * i + 8);
+    mat_row_3 = _mm256_loadu_ps(mat + 8 * i + 16);
+    mat_row_4 = _mm256_loadu_ps(mat + 8 * i + 24);
+    for (int v = 0; v < n_vecs; ++v) {
+      // same reduction as the 4 row step of the single vector kernel
+      a = _mm256_hadd_ps(mat_row_1 * in[v], mat_row_2 * in[v]);
+      c = _mm256_hadd_ps(mat_row_3 * in[v], mat_row_4 * in[v]);
+      a = _mm256_hadd_ps(a, c);
+      f4 = _mm256_extractf128_ps(a, 1) + _mm256_castps256_ps128(a);
+      _mm_storeu_ps(out_data[v] + i, f4);
+    }
+  }
+  for (; i < n_rows; ++i) {
+    mat_row_1 = _mm256_loadu_ps(mat + 8 * i);
+    for (int v = 0; v < n_vecs; ++v) {
+      a = mat_row_1 * in[v];
+      f4 = _mm256_extractf128_ps(a, 1) + _mm256_castps256_ps128(a);
+      f4 = f4 + _mm_permute_ps(f4, 0x4E);
+      f4 = f4 + _mm_movehdup_ps(f4);
+      _MM_EXTRACT_FLOAT(out_data[v][i], f4, 0);
+    }
+  }
+}
+
+// [f64][n_rows][4] × n_vecs
+template <int n_vecs>
+INLINE void matvec_multi_block(
+    f64 const* mat,
+    f64 const* const* in_data,
+    f64* const* out_data,
+    std::size_t n_rows,
+    int_constant<4>) {
+  static_assert(n_vecs > 0);
+  __m256d in[static_cast<std::size_t>(n_vecs)];
+  __m256d mat_row_1;
+  __m256d mat_row_2;
+  __m256d a;
+  __m128d sums;
+  for (int v = 0; v < n_vecs; ++v) {
+    in[v] = _mm256_loadu_pd(in_data[v]);
+  }
+
+  std::size_t i = 0;
+  for (; i + 2 <= n_rows; i += 2) {
+    mat_row_1 = _mm256_loadu_pd(mat + 4 * i);
+    mat_row_2 = _mm256_loadu_pd(mat + 4 * i + 4);
+    for (int v = 0; v < n_vecs; ++v) {
+      a = _mm256_hadd_pd(mat_row_1 * in[v], mat_row_2 * in[v]);
+      sums = _mm256_extractf128_pd(a, 1) + _mm256_castpd256_pd128(a);
+      _mm_storeu_pd(out_data[v] + i, sums);
+    }
+  }
+  if (i < n_rows) {
+    mat_row_1 = _mm256_loadu_pd(mat + 4 * i);
+    for (int v = 0; v < n_vecs; ++v) {
+      a = mat_row_1 * in[v];
+      sums = _mm256_extractf128_pd(a, 1) + _mm256_castpd256_pd128(a);
+      out_data[v][i] = sums[0] + sums[1];
+    }
+  }
+}
+
+// [T][n_rows][n_cols] × n_vecs, all vectors multiplied by the same matrix.
+// The matrix is streamed once, MaxStaticRows rows at a time, and each block
+// of rows is reused for every vector while it is in registers or L1
+template <typename T, int n_cols>
+void matvec_multi(
+    T const* mat,
+    T const* const* in_data,
+    T* const* out_data,
+    int n_vecs,
+    std::size_t n_rows,
+    int_constant<n_cols>) {
+  T* out_block[MultiVecBlock];
+  for (std::size_t first = 0; first < n_rows; first += MaxStaticRows) {
+    std::size_t rows = std::min<std::size_t>(MaxStaticRows, n_rows - first);
+    T const* mat_block = mat + first * n_cols;
+    for (int v = 0; v < n_vecs; v += MultiVecBlock) {
+      int k = std::min(MultiVecBlock, n_vecs - v);
+      for (int w = 0; w < k; ++w) {
+        out_block[w] = out_data[v + w] + first;
+      }
+      auto ins = in_data + v;
+      switch (k) {
+      case 1:
+        matvec_multi_block<1>(
+            mat_block, ins, out_block, rows, int_constant<n_cols>{});
+        break;
+      case 2:
+        matvec_multi_block<2>(
+            mat_block, ins, out_block, rows, int_constant<n_cols>{});
+        break;
+      case 3:
+        matvec_multi_block<3>(
+            mat_block, ins, out_block, rows, int_constant<n_cols>{});
+        break;
+      default:
+        matvec_multi_block<4>(
+            mat_block, ins, out_block, rows, int_constant<n_cols>{});
+        break;
+      }
+    }
+  }
+}
 #endif
@@ -0,0 +1,372 @@
+#ifndef INCLUDE_STRIDED
+#define INCLUDE_STRIDED
+#include <algorithm>
+#include <cstdint>
+
+#include "simd.hpp"
+
+// Kernels for operands whose rows are not densely packed: row i starts at
+// mat + row_stride * i, in elements. This covers a column slice of a wider
+// row-major matrix (mat at the first column, row_stride its full width) as
+// well as every k-th row (row_stride k times the width), without copying.
+// With Aligned, every row starts on a RowAlign byte boundary and whole rows
+// are read with aligned loads.
+
+template <typename T, int n_cols>
+constexpr std::size_t RowAlign = std::min<std::size_t>(32, sizeof(T) * n_cols);
+
+template <bool Aligned> INLINE __m256 load_row(f32 const* p, int_constant<8>) {
+  if constexpr (Aligned) {
+    return _mm256_load_ps(p);
+  } else {
+    return _mm256_loadu_ps(p);
+  }
+}
+template <bool Aligned> INLINE __m128 load_row(f32 const* p, int_constant<4>) {
+  if constexpr (Aligned) {
+    return _mm_load_ps(p);
+  } else {
+    return _mm_loadu_ps(p);
+  }
+}
+// 8 bytes, alignment does not matter
+template <bool Aligned> INLINE __m128 load_row(f32 const* p, int_constant<2>) {
+  return _mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(p)));
+}
+template <bool Aligned> INLINE __m256d load_row(f64 const* p, int_constant<4>) {
+  if constexpr (Aligned) {
+    return _mm256_load_pd(p);
+  } else {
+    return _mm256_loadu_pd(p);
+  }
+}
+template <bool Aligned> INLINE __m128d load_row(f64 const* p, int_constant<2>) {
+  if constexpr (Aligned) {
+    return _mm_load_pd(p);
+  } else {
+    return _mm_loadu_pd(p);
+  }
+}
+
+// [f32][n_rows][8], strided
+template <int n_rows, bool Aligned>
+INLINE void matvec_strided_inline(
+    f32 const* mat,
+    std::size_t row_stride,
+    f32 const* in_data,
+    f32* out_data,
+    int_constant<8>) {
+  __m256 in;
+  in = _mm256_loadu_ps(in_data);
+
+  auto row = [&](int i) {
+    return load_row<Aligned>(
+        mat + row_stride * static_cast<std::size_t>(i), int_constant<8>{});
+  };
+
+  // 8 rows at a time, at row 8xi
+  auto batch_8 = [&](int i) {
+    auto product = [&](int k) { return row(8 * i + k) * in; };
+    _mm256_storeu_ps(
+        out_data + 8 * i,
+        transpose_sum_8(
+            product(0),
+            product(1),
+            product(2),
+            product(3),
+            product(4),
+            product(5),
+            product(6),
+            product(7)));
+  };
+  auto batch_1 = [&](int i) {
+    matvec_simd_inline<1>(
+        mat + row_stride * static_cast<std::size_t>(i),
+        in_data,
+        out_data + i,
+        int_constant<8>{});
+  };
+  unroll<UnrollNum, 0, n_rows / 8>(batch_8);
+  unroll<1, n_rows / 8 * 8, n_rows % 8>(batch_1);
+}
+
+// [f32][n_rows][4], strided
+template <int n_rows, bool Aligned>
+INLINE void matvec_strided_inline(
+    f32 const* mat,
+    std::size_t row_stride,
+    f32 const* in_data,
+    f32* out_data,
+    int_constant<4>) {
+  __m256 in;
+  __m256 mat_row_12;
+  __m256 mat_row_34;
+  __m128 f4;
+  __m128 f4_2;
+  in = _mm256_loadu2_m128(in_data, in_data);
+
+  auto row = [&](int i) {
+    return load_row<Aligned>(
+        mat + row_stride * static_cast<std::size_t>(i), int_constant<4>{});
+  };
+
+  // 4 rows at a time, at row 4xi
+  auto batch_4 = [&](int i) {
+    // a0 a1 a2 a3 | b0 b1 b2 b3
+    mat_row_12 = _mm256_set_m128(row(4 * i + 1), row(4 * i)) * in;
+    // c0 c1 c2 c3 | d0 d1 d2 d3
+    mat_row_34 = _mm256_set_m128(row(4 * i + 3), row(4 * i + 2)) * in;
+
+    // a0 + a1 | a2 + a3 | c0 + c1 | c2 + c3 | =>
+    // b0 + b1 | b2 + b3 | d0 + d1 | d2 + d3
+    mat_row_12 = _mm256_hadd_ps(mat_row_12, mat_row_34);
+    f4 = __builtin_shufflevector(mat_row_12, mat_row_12, 0, 4, 2, 6);
+    f4_2 = __builtin_shufflevector(mat_row_12, mat_row_12, 1, 5, 3, 7);
+    _mm_storeu_ps(out_data + 4 * i, f4 + f4_2);
+  };
+  auto batch_1 = [&](int i) {
+    matvec_simd_inline<1>(
+        mat + row_stride * static_cast<std::size_t>(i),
+        in_data,
+        out_data + i,
+        int_constant<4>{});
+  };
+  unroll<UnrollNum, 0, n_rows / 4>(batch_4);
+  unroll<1, n_rows / 4 * 4, n_rows % 4>(batch_1);
+}
+
+// [f32][n_rows][2], strided
+template <int n_rows, bool Aligned>
+INLINE void matvec_strided_inline(
+    f32 const* mat,
+    std::size_t row_stride,
+    f32 const* in_data,
+    f32* out_data,
+    int_constant<2>) {
+  __m256 in;
+  __m256 mat_row_1;
+  __m256 mat_row_2;
+  in = _mm256_setr_ps(
+      in_data[0],
+      in_data[1],
+      in_data[0],
+      in_data[1],
+      in_data[0],
+      in_data[1],
+      in_data[0],
+      in_data[1]);
+
+  auto row = [&](int i) {
+    return load_row<Aligned>(
+        mat + row_stride * static_cast<std::size_t>(i), int_constant<2>{});
+  };
+  // a0 a1 b0 b1 c0 c1 d0 d1, rows i to i + 4
+  auto rows_4 = [&](int i) {
+    return _mm256_set_m128(
+        _mm_movelh_ps(row(i + 2), row(i + 3)),
+        _mm_movelh_ps(row(i), row(i + 1)));
+  };
+
+  // 8 rows at a time, at row 8xi
+  auto batch_8 = [&](int i) {
+    mat_row_1 = rows_4(8 * i) * in;
+    mat_row_2 = rows_4(8 * i + 4) * in;
+    // a b e f c d g h
+    mat_row_1 = _mm256_hadd_ps(mat_row_1, mat_row_2);
+    mat_row_1 =
+        __builtin_shufflevector(mat_row_1, mat_row_1, 0, 1, 4, 5, 2, 3, 6, 7);
+    _mm256_storeu_ps(out_data + 8 * i, mat_row_1);
+  };
+  auto batch_1 = [&](int i) {
+    f32 const* mat_row = mat + row_stride * static_cast<std::size_t>(i);
+    out_data[i] = in_data[0] * mat_row[0] + in_data[1] * mat_row[1];
+  };
+  unroll<UnrollNum, 0, n_rows / 8>(batch_8);
+  unroll<1, n_rows / 8 * 8, n_rows % 8>(batch_1);
+}
+
+// [f64][n_rows][8], strided
+template <int n_rows, bool Aligned>
+INLINE void matvec_strided_inline(
+    f64 const* mat,
+    std::size_t row_stride,
+    f64 const* in_data,
+    f64* out_data,
+    int_constant<8>) {
+  __m256d in_1;
+  __m256d in_2;
+  in_1 = _mm256_loadu_pd(in_data);
+  in_2 = _mm256_loadu_pd(in_data + 4);
+
+  // a0 + a4 | a1 + a5 | a2 + a6 | a3 + a7
+  auto row = [&](int i) {
+    f64 const* mat_row = mat + row_stride * static_cast<std::size_t>(i);
+    return _mm256_fmadd_pd(
+        load_row<Aligned>(mat_row + 4, int_constant<4>{}),
+        in_2,
+        load_row<Aligned>(mat_row, int_constant<4>{}) * in_1);
+  };
+
+  // 4 rows at a time, at row 4xi
+  auto batch_4 = [&](int i) {
+    _mm256_storeu_pd(
+        out_data + 4 * i,
+        transpose_sum_4(
+            row(4 * i), row(4 * i + 1), row(4 * i + 2), row(4 * i + 3)));
+  };
+  auto batch_1 = [&](int i) {
+    matvec_simd_inline<1>(
+        mat + row_stride * static_cast<std::size_t>(i),
+        in_data,
+        out_data + i,
+        int_constant<8>{});
+  };
+  unroll<UnrollNum, 0, n_rows / 4>(batch_4);
+  unroll<1, n_rows / 4 * 4, n_rows % 4>(batch_1);
+}
+
+// [f64][n_rows][4], strided
+template <int n_rows, bool Aligned>
+INLINE void matvec_strided_inline(
+    f64 const* mat,
+    std::size_t row_stride,
+    f64 const* in_data,
+    f64* out_data,
+    int_constant<4>) {
+  __m256d in;
+  in = _mm256_loadu_pd(in_data);
+
+  auto row = [&](int i) {
+    return load_row<Aligned>(
+        mat + row_stride * static_cast<std::size_t>(i), int_constant<4>{});
+  };
+
+  // 4 rows at a time, at row 4xi
+  auto batch_4 = [&](int i) {
+    auto product = [&](int k) { return row(4 * i + k) * in; };
+    _mm256_storeu_pd(
+        out_data + 4 * i,
+        transpose_sum_4(product(0), product(1), product(2), product(3)));
+  };
+  auto batch_1 = [&](int i) {
+    matvec_simd_inline<1>(
+        mat + row_stride * static_cast<std::size_t>(i),
+        in_data,
+        out_data + i,
+        int_constant<4>{});
+  };
+  unroll<UnrollNum, 0, n_rows / 4>(batch_4);
+  unroll<1, n_rows / 4 * 4, n_rows % 4>(batch_1);
+}
+
+// [f64][n_rows][2], strided
+template <int n_rows, bool Aligned>
+INLINE void matvec_strided_inline(
+    f64 const* mat,
+    std::size_t row_stride,
+    f64 const* in_data,
+    f64* out_data,
+    int_constant<2>) {
+  __m256d in;
+  __m256d mat_row_12;
+  __m256d mat_row_34;
+  in = _mm256_loadu2_m128d(in_data, in_data);
+
+  auto row = [&](int i) {
+    return load_row<Aligned>(
+        mat + row_stride * static_cast<std::size_t>(i), int_constant<2>{});
+  };
+
+  // 4 rows at a time, starting at row 4*i
+  auto batch_4 = [&](int i) {
+    // a0 a1 b0 b1
+    mat_row_12 = _mm256_set_m128d(row(4 * i + 1), row(4 * i)) * in;
+    // c0 c1 d0 d1
+    mat_row_34 = _mm256_set_m128d(row(4 * i + 3), row(4 * i + 2)) * in;
+
+    // a0 + a1 | c0 + c1 | b0 + b1 | d0 + d1
+    mat_row_12 = _mm256_hadd_pd(mat_row_12, mat_row_34);
+    // a0 + a1 | b0 + b1 | c0 + c1 | d0 + d1
+    mat_row_12 = _mm256_permute4x64_pd(mat_row_12, 0xD8);
+    _mm256_storeu_pd(out_data + 4 * i, mat_row_12);
+  };
+  auto batch_1 = [&](int i) {
+    f64 const* mat_row = mat + row_stride * static_cast<std::size_t>(i);
+    out_data[i] = in_data[0] * mat_row[0] + in_data[1] * mat_row[1];
+  };
+  unroll<UnrollNum, 0, n_rows / 4>(batch_4);
+  unroll<1, n_rows / 4 * 4, n_rows % 4>(batch_1);
+}
+
+// [T][n_rows][n_cols] with row i at mat + row_stride * i. Uses aligned loads
+// when mat and the stride allow it
+template <int n_rows, typename T, int n_cols>
+NOINLINE void matvec_strided(
+    T const* mat,
+    std::size_t row_stride,
+    T const* in_data,
+    T* out_data,
+    int_constant<n_cols>) {
+  constexpr std::size_t align = RowAlign<T, n_cols>;
+  if (reinterpret_cast<std::uintptr_t>(mat) % align == 0 and
+      row_stride * sizeof(T) % align == 0) {
+    matvec_strided_inline<n_rows, true>(
+        mat, row_stride, in_data, out_data, int_constant<n_cols>{});
+  } else {
+    matvec_strided_inline<n_rows, false>(
+        mat, row_stride, in_data, out_data, int_constant<n_cols>{});
+  }
+}
+
+template <typename T, int n_cols, std::size_t... Ns>
+constexpr auto make_strided_table(std::index_sequence<Ns...>) {
+  using kernel_t =
+      void (*)(T const*, std::size_t, T const*, T*, int_constant<n_cols>);
+  return std::array<kernel_t, sizeof...(Ns)>{
+      static_cast<kernel_t>(&matvec_strided<static_cast<int>(Ns)>)...};
+}
+
+// [T][n_rows][n_cols], strided, n_rows only known at runtime
+template <typename T, int n_cols>
+void matvec_strided_n(
+    T const* mat,
+    std::size_t row_stride,
+    T const* in_data,
+    T* out_data,
+    std::size_t n_rows,
+    int_constant<n_cols>) {
+  static constexpr auto table = make_strided_table<T, n_cols>(
+      std::make_index_sequence<MaxStaticRows>());
+
+  for (; n_rows >= MaxStaticRows; n_rows -= MaxStaticRows) {
+    matvec_strided<MaxStaticRows>(
+        mat, row_stride, in_data, out_data, int_constant<n_cols>{});
+    mat += MaxStaticRows * row_stride;
+    out_data += MaxStaticRows;
+  }
+  table[n_rows](mat, row_stride, in_data, out_data, int_constant<n_cols>{});
+}
+
+// Sub-block of a row-major matrix with leading dimension ld (elements per
+// row): rows first_row, first_row + row_step, ... of columns
+// [first_col, first_col + n_cols)
+template <typename T, int n_cols>
+void matvec_sub_block(
+    T const* mat,
+    std::size_t ld,
+    std::size_t first_row,
+    std::size_t first_col,
+    std::size_t row_step,
+    T const* in_data,
+    T* out_data,
+    std::size_t n_rows,
+    int_constant<n_cols>) {
+  matvec_strided_n(
+      mat + first_row * ld + first_col,
+      ld * row_step,
+      in_data,
+      out_data,
+      n_rows,
+      int_constant<n_cols>{});
+}
+#endif
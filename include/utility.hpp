@@ -1,7 +1,10 @@
 #ifndef INCLUDE_UTILITY
 #define INCLUDE_UTILITY
+#include <cerrno>
 #include <climits>
 #include <cstddef>
+#include <string>
+#include <system_error>
 #include <utility>
 
 #ifdef _MSC_VER
@@ -36,6 +39,10 @@ template <int Start, int End, typename Fn> void for_each(Fn const& fn) {
   for_each_impl<Fn, Start>(fn, std::make_index_sequence<End - Start>());
 }
 
+[[noreturn]] inline void throw_errno(std::string const& what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
 template <typename... Ts> void unused(Ts const&...){};
 
 template <typename T>
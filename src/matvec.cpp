@@ -0,0 +1,132 @@
+#include <array>
+#include <utility>
+
+#include "matvec.h"
+#include "simd.hpp"
+
+namespace {
+
+static_assert(MATVEC_MAX_TABLE_ROWS == MaxStaticRows);
+
+// Entry points stored in the tables. The kernel body is inlined into each
+// one, so a call through the table is a single indirect call
+template <int n_rows, typename T, int n_cols>
+void kernel_entry(T const* mat, T const* in_data, T* out_data) {
+  matvec_simd_best_inline<n_rows>(
+      mat, in_data, out_data, int_constant<n_cols>{});
+}
+
+template <typename T> using kernel_t = void (*)(T const*, T const*, T*);
+
+template <typename T, int n_cols, std::size_t... Ns>
+constexpr std::array<kernel_t<T>, sizeof...(Ns)>
+make_table(std::index_sequence<Ns...>) {
+  return {&kernel_entry<static_cast<int>(Ns), T, n_cols>...};
+}
+
+// [2|4|8 columns][n_rows], n_rows in [0, MaxStaticRows]
+template <typename T>
+constexpr std::array<std::array<kernel_t<T>, MaxStaticRows + 1>, 3> tables = {
+    make_table<T, 2>(std::make_index_sequence<MaxStaticRows + 1>()),
+    make_table<T, 4>(std::make_index_sequence<MaxStaticRows + 1>()),
+    make_table<T, 8>(std::make_index_sequence<MaxStaticRows + 1>()),
+};
+
+constexpr int col_index(std::size_t n_cols) {
+  switch (n_cols) {
+  case 2:
+    return 0;
+  case 4:
+    return 1;
+  case 8:
+    return 2;
+  default:
+    return -1;
+  }
+}
+
+template <typename T>
+kernel_t<T> get_kernel(std::size_t n_rows, std::size_t n_cols) {
+  int c = col_index(n_cols);
+  if (c < 0 or n_rows > MaxStaticRows) {
+    return nullptr;
+  }
+  return tables<T>[static_cast<std::size_t>(c)][n_rows];
+}
+
+template <typename T>
+matvec_status prod(
+    std::size_t n_rows, std::size_t n_cols, T const* mat, T const* in, T* out) {
+  int c = col_index(n_cols);
+  if (c < 0) {
+    return MATVEC_INVALID_COLS;
+  }
+  auto const& table = tables<T>[static_cast<std::size_t>(c)];
+  for (; n_rows > MaxStaticRows; n_rows -= MaxStaticRows) {
+    table[MaxStaticRows](mat, in, out);
+    mat += MaxStaticRows * n_cols;
+    out += MaxStaticRows;
+  }
+  table[n_rows](mat, in, out);
+  return MATVEC_OK;
+}
+
+} // namespace
+
+extern "C" {
+
+matvec_status matvec_prod(
+    matvec_dtype type,
+    size_t n_rows,
+    size_t n_cols,
+    void const* mat,
+    void const* in,
+    void* out) {
+  switch (type) {
+  case MATVEC_F32:
+    return prod(
+        n_rows,
+        n_cols,
+        static_cast<f32 const*>(mat),
+        static_cast<f32 const*>(in),
+        static_cast<f32*>(out));
+  case MATVEC_F64:
+    return prod(
+        n_rows,
+        n_cols,
+        static_cast<f64 const*>(mat),
+        static_cast<f64 const*>(in),
+        static_cast<f64*>(out));
+  default:
+    return MATVEC_INVALID_TYPE;
+  }
+}
+
+matvec_status matvec_prod_f32(
+    size_t n_rows,
+    size_t n_cols,
+    float const* mat,
+    float const* in,
+    float* out) {
+  return prod(n_rows, n_cols, mat, in, out);
+}
+
+matvec_status matvec_prod_f64(
+    size_t n_rows,
+    size_t n_cols,
+    double const* mat,
+    double const* in,
+    double* out) {
+  return prod(n_rows, n_cols, mat, in, out);
+}
+
+matvec_kernel_f32 matvec_get_kernel_f32(size_t n_rows, size_t n_cols) {
+  return get_kernel<f32>(n_rows, n_cols);
+}
+
+matvec_kernel_f64 matvec_get_kernel_f64(size_t n_rows, size_t n_cols) {
+  return get_kernel<f64>(n_rows, n_cols);
+}
+
+int matvec_abi_version(void) { return 1; }
+}
@@ -0,0 +1,116 @@
+#include <memory>
+#include <vector>
+
+#include "bench.hpp"
+
+EXTERN_128_ALL;
+
+#ifndef ARENA_BATCH
+#define ARENA_BATCH 1000000
+#endif
+
+template <typename T, int n_rows, int n_cols> struct job {
+  Mat<T, n_rows, n_cols>* mat;
+  Vec<T, n_cols>* in;
+  Vec<T, n_rows>* out;
+};
+
+// Each job allocated separately with new, as a naive batch would
+template <typename T, int n_rows, int n_cols> struct heap_batch {
+  std::vector<job<T, n_rows, n_cols> > jobs;
+
+  heap_batch() {
+    jobs.reserve(ARENA_BATCH);
+    for (int i = 0; i < ARENA_BATCH; ++i) {
+      jobs.push_back(
+          {new Mat<T, n_rows, n_cols>{},
+           new Vec<T, n_cols>{},
+           new Vec<T, n_rows>{}});
+    }
+  }
+  heap_batch(heap_batch const&) = delete;
+  heap_batch& operator=(heap_batch const&) = delete;
+  ~heap_batch() {
+    for (auto const& j : jobs) {
+      delete j.mat;
+      delete j.in;
+      delete j.out;
+    }
+  }
+};
+
+// Same jobs placed back to back in a huge page backed arena
+template <typename T, int n_rows, int n_cols> struct arena_batch {
+  arena storage{64, true};
+  std::vector<job<T, n_rows, n_cols> > jobs;
+
+  arena_batch() {
+    jobs.reserve(ARENA_BATCH);
+    for (int i = 0; i < ARENA_BATCH; ++i) {
+      jobs.push_back(
+          {storage.make<Mat<T, n_rows, n_cols> >(),
+           storage.make<Vec<T, n_cols> >(),
+           storage.make<Vec<T, n_rows> >()});
+    }
+  }
+};
+
+template <typename Batch> NOINLINE void bm_alloc(benchmark::State& state) {
+  for (const auto& _ : state) {
+    unused(_);
+    auto batch = std::make_unique<Batch>();
+    benchmark::DoNotOptimize(batch->jobs.data());
+  }
+  state.SetItemsProcessed(state.iterations() * ARENA_BATCH);
+}
+
+template <typename Batch> NOINLINE void bm_prod(benchmark::State& state) {
+  auto batch = std::make_unique<Batch>();
+  for (const auto& _ : state) {
+    unused(_);
+    for (auto const& j : batch->jobs) {
+      matvec::prod(*j.mat, *j.in, *j.out);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * ARENA_BATCH);
+}
+
+template <typename T, int n_rows, int n_cols>
+NOINLINE void bm_alloc_heap(benchmark::State& state) {
+  bm_alloc<heap_batch<T, n_rows, n_cols> >(state);
+}
+template <typename T, int n_rows, int n_cols>
+NOINLINE void bm_alloc_arena(benchmark::State& state) {
+  bm_alloc<arena_batch<T, n_rows, n_cols> >(state);
+}
+template <typename T, int n_rows, int n_cols>
+NOINLINE void bm_prod_heap(benchmark::State& state) {
+  bm_prod<heap_batch<T, n_rows, n_cols> >(state);
+}
+template <typename T, int n_rows, int n_cols>
+NOINLINE void bm_prod_arena(benchmark::State& state) {
+  bm_prod<arena_batch<T, n_rows, n_cols> >(state);
+}
+
+#define RUN_ARENA_BENCHMARKS(T, NCols, NRows)                                  \
+  BENCHMARK_TEMPLATE(bm_alloc_heap, T, NRows, NCols)                           \
+      ->Unit(benchmark::kMillisecond);                                         \
+  BENCHMARK_TEMPLATE(bm_alloc_arena, T, NRows, NCols)                          \
+      ->Unit(benchmark::kMillisecond);                                         \
+  BENCHMARK_TEMPLATE(bm_prod_heap, T, NRows, NCols)                            \
+      ->Unit(benchmark::kMillisecond);                                         \
+  BENCHMARK_TEMPLATE(bm_prod_arena, T, NRows, NCols)                           \
+      ->Unit(benchmark::kMillisecond)
+
+RUN_ARENA_BENCHMARKS(FLOAT_TYPE, NCOLS, 2);
+RUN_ARENA_BENCHMARKS(FLOAT_TYPE, NCOLS, 8);
+
+#define CAT0(x, y) x##_##y
+#define CAT(x, y) CAT0(x, y)
+#define STRINGIZE0(x) #x
+#define STRINGIZE(x) STRINGIZE0(x)
+
+int main() {
+  run_bench(STRINGIZE(CAT(FLOAT_TYPE, NCOLS)) "_arena");
+}
@@ -0,0 +1,158 @@
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "batch.hpp"
+#include "bench.hpp"
+
+#ifndef BATCH_JOBS
+#define BATCH_JOBS 10000
+#endif
+
+// Mixed f32/f64 batch with 2, 4 or 8 columns and a long tailed row count,
+// shuffled as it would be submitted
+struct mixed_batch {
+  std::vector<f32> f32_data;
+  std::vector<f64> f64_data;
+  std::vector<batch_job> jobs;
+
+  mixed_batch() {
+    std::mt19937 gen(0);
+    std::uniform_int_distribution<int> type_dist(0, 1);
+    std::uniform_int_distribution<int> col_dist(0, 2);
+    std::geometric_distribution<int> row_dist(1.0 / 64);
+
+    struct shape {
+      int type;
+      std::size_t n_cols;
+      std::size_t n_rows;
+    };
+    std::vector<shape> shapes;
+    std::size_t f32_size = 0;
+    std::size_t f64_size = 0;
+    for (int i = 0; i < BATCH_JOBS; ++i) {
+      shape s{
+          type_dist(gen),
+          std::size_t{2} << col_dist(gen),
+          1 + static_cast<std::size_t>(row_dist(gen))};
+      std::size_t size = s.n_rows * s.n_cols + s.n_cols + s.n_rows;
+      (s.type == 0 ? f32_size : f64_size) += size;
+      shapes.push_back(s);
+    }
+    f32_data.assign(f32_size, 1);
+    f64_data.assign(f64_size, 1);
+
+    f32* p32 = f32_data.data();
+    f64* p64 = f64_data.data();
+    for (auto const& s : shapes) {
+      if (s.type == 0) {
+        jobs.push_back(make(p32, s.n_rows, s.n_cols));
+      } else {
+        jobs.push_back(make(p64, s.n_rows, s.n_cols));
+      }
+    }
+  }
+
+  template <typename T>
+  static batch_job make(T*& p, std::size_t n_rows, std::size_t n_cols) {
+    T* mat = p;
+    T* in = mat + n_rows * n_cols;
+    T* out = in + n_cols;
+    p = out + n_rows;
+    switch (n_cols) {
+    case 2:
+      return make_job<2>(mat, in, out, n_rows);
+    case 4:
+      return make_job<4>(mat, in, out, n_rows);
+    default:
+      return make_job<8>(mat, in, out, n_rows);
+    }
+  }
+};
+
+mixed_batch const& batch() {
+  static mixed_batch const b;
+  return b;
+}
+
+NOINLINE void bm_batch_serial(benchmark::State& state) {
+  auto jobs = batch().jobs;
+  for (const auto& _ : state) {
+    unused(_);
+    for (auto const& j : jobs) {
+      j();
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(
+      state.iterations() * static_cast<std::int64_t>(jobs.size()));
+}
+
+// Equal job counts per thread, in submission order
+NOINLINE void bm_batch_static(benchmark::State& state) {
+  batch_executor pool(static_cast<unsigned>(state.range(0)));
+  auto jobs = batch().jobs;
+  for (const auto& _ : state) {
+    unused(_);
+    pool.run_static(jobs);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(
+      state.iterations() * static_cast<std::int64_t>(jobs.size()));
+}
+
+// Equal job counts per thread, sorted by shape first
+NOINLINE void bm_batch_static_sorted(benchmark::State& state) {
+  batch_executor pool(static_cast<unsigned>(state.range(0)));
+  auto const& submitted = batch().jobs;
+  std::vector<batch_job> jobs;
+  for (const auto& _ : state) {
+    unused(_);
+    state.PauseTiming();
+    jobs = submitted;
+    state.ResumeTiming();
+    sort_by_shape(jobs);
+    pool.run_static(jobs);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(
+      state.iterations() * static_cast<std::int64_t>(jobs.size()));
+}
+
+// Sorted by shape, cost balanced, work stealing
+NOINLINE void bm_batch_stealing(benchmark::State& state) {
+  batch_executor pool(static_cast<unsigned>(state.range(0)));
+  auto const& submitted = batch().jobs;
+  std::vector<batch_job> jobs;
+  for (const auto& _ : state) {
+    unused(_);
+    state.PauseTiming();
+    jobs = submitted;
+    state.ResumeTiming();
+    pool.run(jobs);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(
+      state.iterations() * static_cast<std::int64_t>(jobs.size()));
+}
+
+// Argument: number of threads, calling thread included
+BENCHMARK(bm_batch_serial)->UseRealTime()->Unit(benchmark::kMicrosecond);
+BENCHMARK(bm_batch_static)
+    ->RangeMultiplier(2)
+    ->Range(1, 16)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(bm_batch_static_sorted)
+    ->RangeMultiplier(2)
+    ->Range(1, 16)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+BENCHMARK(bm_batch_stealing)
+    ->RangeMultiplier(2)
+    ->Range(1, 16)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+int main() { run_bench("batch"); }
@@ -1,3 +1,4 @@
+#include <cstdlib>
 #include <filesystem>
 
 #include "fmt/color.h"
@@ -6,14 +7,29 @@
 
 #include "bench.hpp"
 
+// Environment:
+// BENCH_OUT          output directory, "bench_out" by default
+// BENCH_REPETITIONS  runs of each benchmark, every one of them is kept in the
+//                    JSON output so that result sets can be compared with
+//                    `draw_plots.py --compare`
+std::string bench_out_dir() {
+  char const* out_env = std::getenv("BENCH_OUT");
+  std::string out_dir = out_env != nullptr ? out_env : "bench_out";
+  std::filesystem::create_directories(out_dir);
+  return out_dir;
+}
+
 void run_bench(const std::string& name) {
-  namespace fs = std::filesystem;
-  fs::create_directory("bench_out");
+  std::string out_file = fmt::format("{}/{}.json", bench_out_dir(), name);
+
   std::vector<std::string> arg_str = {
-      name,                                                  //
-      "--benchmark_format=json",                             //
-      fmt::format("--benchmark_out=bench_out/{}.json", name) //
+      name,                                          //
+      "--benchmark_format=json",                     //
+      fmt::format("--benchmark_out={}", out_file)    //
   };
+  if (char const* reps = std::getenv("BENCH_REPETITIONS")) {
+    arg_str.push_back(fmt::format("--benchmark_repetitions={}", reps));
+  }
 
   std::vector<char*> argv;
   argv.reserve(arg_str.size());
@@ -30,7 +46,7 @@ void run_bench(const std::string& name) {
   if (benchmark::ReportUnrecognizedArguments(argc, argv.data())) {
     std::exit(1);
   }
-  std::ofstream json_file(fmt::format("bench_out/{}.json", name));
+  std::ofstream json_file(out_file);
   benchmark::JSONReporter json;
   json.SetOutputStream(&json_file);
   json.SetErrorStream(&std::cerr);
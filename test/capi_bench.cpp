@@ -0,0 +1,89 @@
+#include <type_traits>
+#include <vector>
+
+#include "bench.hpp"
+#include "matvec.h"
+
+// Direct template call against the C entry points of libmatvec
+
+template <typename T> struct capi_;
+template <> struct capi_<f32> {
+  static constexpr matvec_dtype type = MATVEC_F32;
+  static constexpr auto prod = &matvec_prod_f32;
+  static constexpr auto get_kernel = &matvec_get_kernel_f32;
+};
+template <> struct capi_<f64> {
+  static constexpr matvec_dtype type = MATVEC_F64;
+  static constexpr auto prod = &matvec_prod_f64;
+  static constexpr auto get_kernel = &matvec_get_kernel_f64;
+};
+
+template <typename T, int n_rows, int n_cols, typename Fn>
+void bm_call(benchmark::State& state, Fn const& fn) {
+  std::vector<T> mat(n_rows * n_cols);
+  std::vector<T> in(n_cols);
+  std::vector<T> out(n_rows);
+  for (const auto& _ : state) {
+    unused(_);
+    benchmark::DoNotOptimize(mat.data());
+    benchmark::DoNotOptimize(in.data());
+    fn(mat.data(), in.data(), out.data());
+    benchmark::ClobberMemory();
+  }
+}
+
+template <typename T, int n_rows, int n_cols>
+NOINLINE void bm_direct(benchmark::State& state) {
+  bm_call<T, n_rows, n_cols>(state, [](T const* m, T const* i, T* o) {
+    matvec_simd<n_rows>(m, i, o, int_constant<n_cols>{});
+  });
+}
+
+// Type and shape resolved on every call
+template <typename T, int n_rows, int n_cols>
+NOINLINE void bm_capi_generic(benchmark::State& state) {
+  bm_call<T, n_rows, n_cols>(state, [](T const* m, T const* i, T* o) {
+    matvec_prod(capi_<T>::type, n_rows, n_cols, m, i, o);
+  });
+}
+
+template <typename T, int n_rows, int n_cols>
+NOINLINE void bm_capi_typed(benchmark::State& state) {
+  bm_call<T, n_rows, n_cols>(state, [](T const* m, T const* i, T* o) {
+    capi_<T>::prod(n_rows, n_cols, m, i, o);
+  });
+}
+
+// Kernel looked up once, outside of the loop
+template <typename T, int n_rows, int n_cols>
+NOINLINE void bm_capi_kernel(benchmark::State& state) {
+  auto kernel = capi_<T>::get_kernel(n_rows, n_cols);
+  bm_call<T, n_rows, n_cols>(state, [&](T const* m, T const* i, T* o) {
+    kernel(m, i, o);
+  });
+}
+
+#define RUN_CAPI_BENCHMARKS(T, NCols, NRows)                                   \
+  BENCHMARK_TEMPLATE(bm_direct, T, NRows, NCols);                              \
+  BENCHMARK_TEMPLATE(bm_capi_generic, T, NRows, NCols);                        \
+  BENCHMARK_TEMPLATE(bm_capi_typed, T, NRows, NCols);                          \
+  BENCHMARK_TEMPLATE(bm_capi_kernel, T, NRows, NCols)
+
+RUN_CAPI_BENCHMARKS(FLOAT_TYPE, NCOLS, 1);
+RUN_CAPI_BENCHMARKS(FLOAT_TYPE, NCOLS, 4);
+RUN_CAPI_BENCHMARKS(FLOAT_TYPE, NCOLS, 16);
+RUN_CAPI_BENCHMARKS(FLOAT_TYPE, NCOLS, 64);
+RUN_CAPI_BENCHMARKS(FLOAT_TYPE, NCOLS, 128);
+
+// Above the table: blocks of 128 rows, then the remainder
+BENCHMARK_TEMPLATE(bm_direct, FLOAT_TYPE, 300, NCOLS);
+BENCHMARK_TEMPLATE(bm_capi_typed, FLOAT_TYPE, 300, NCOLS);
+
+#define CAT0(x, y) x##_##y
+#define CAT(x, y) CAT0(x, y)
+#define STRINGIZE0(x) #x
+#define STRINGIZE(x) STRINGIZE0(x)
+
+int main() {
+  run_bench(STRINGIZE(CAT(FLOAT_TYPE, NCOLS)) "_capi");
+}
@@ -0,0 +1,231 @@
+/* Results and error returns of the C interface of libmatvec, built as C to
+ * check that matvec.h is usable from C. Exits with 1 if any check fails. */
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "matvec.h"
+
+static int failures = 0;
+
+static void expect(int ok, char const* what) {
+  printf("%-56s : %s\n", what, ok ? "pass" : "fail");
+  if (!ok) {
+    ++failures;
+  }
+}
+
+/* Deterministic values in [0, 1) */
+static double next_value(unsigned* state) {
+  *state = *state * 1664525u + 1013904223u;
+  return (double)(*state >> 8) / (double)(1u << 24);
+}
+
+/* Largest error of out against mat * in, relative to sum_j |mat_ij in_j| */
+static double max_rel_err_f32(
+    float const* mat,
+    float const* in,
+    float const* out,
+    size_t n_rows,
+    size_t n_cols) {
+  double err = 0;
+  size_t i;
+  size_t j;
+  for (i = 0; i < n_rows; ++i) {
+    double exact = 0;
+    double scale = 0;
+    for (j = 0; j < n_cols; ++j) {
+      double p = (double)mat[i * n_cols + j] * (double)in[j];
+      exact += p;
+      scale += fabs(p);
+    }
+    double e = fabs((double)out[i] - exact) / scale;
+    if (e > err) {
+      err = e;
+    }
+  }
+  return err;
+}
+
+static double max_rel_err_f64(
+    double const* mat,
+    double const* in,
+    double const* out,
+    size_t n_rows,
+    size_t n_cols) {
+  long double err = 0;
+  size_t i;
+  size_t j;
+  for (i = 0; i < n_rows; ++i) {
+    long double exact = 0;
+    long double scale = 0;
+    for (j = 0; j < n_cols; ++j) {
+      long double p = (long double)mat[i * n_cols + j] * in[j];
+      exact += p;
+      scale += fabsl(p);
+    }
+    long double e = fabsl(out[i] - exact) / scale;
+    if (e > err) {
+      err = e;
+    }
+  }
+  return (double)err;
+}
+
+/* n_rows x n_cols in f32, through matvec_prod, matvec_prod_f32 and, when the
+ * shape is in the table, the kernel returned by matvec_get_kernel_f32 */
+static void check_f32(size_t n_rows, size_t n_cols) {
+  unsigned state = 1;
+  float* mat = malloc(n_rows * n_cols * sizeof(float));
+  float* in = malloc(n_cols * sizeof(float));
+  float* out = malloc(n_rows * sizeof(float));
+  double tol = (double)n_cols * FLT_EPSILON;
+  char what[64];
+  size_t k;
+  for (k = 0; k < n_rows * n_cols; ++k) {
+    mat[k] = (float)next_value(&state);
+  }
+  for (k = 0; k < n_cols; ++k) {
+    in[k] = (float)next_value(&state);
+  }
+
+  snprintf(what, sizeof(what), "[f32][%4zu x %zu] matvec_prod", n_rows, n_cols);
+  expect(
+      matvec_prod(MATVEC_F32, n_rows, n_cols, mat, in, out) == MATVEC_OK &&
+          max_rel_err_f32(mat, in, out, n_rows, n_cols) <= tol,
+      what);
+
+  snprintf(
+      what, sizeof(what), "[f32][%4zu x %zu] matvec_prod_f32", n_rows, n_cols);
+  expect(
+      matvec_prod_f32(n_rows, n_cols, mat, in, out) == MATVEC_OK &&
+          max_rel_err_f32(mat, in, out, n_rows, n_cols) <= tol,
+      what);
+
+  snprintf(
+      what,
+      sizeof(what),
+      "[f32][%4zu x %zu] matvec_get_kernel_f32",
+      n_rows,
+      n_cols);
+  if (n_rows <= MATVEC_MAX_TABLE_ROWS) {
+    matvec_kernel_f32 kernel = matvec_get_kernel_f32(n_rows, n_cols);
+    int ok = kernel != NULL;
+    if (ok) {
+      kernel(mat, in, out);
+      ok = max_rel_err_f32(mat, in, out, n_rows, n_cols) <= tol;
+    }
+    expect(ok, what);
+  } else {
+    expect(matvec_get_kernel_f32(n_rows, n_cols) == NULL, what);
+  }
+
+  free(mat);
+  free(in);
+  free(out);
+}
+
+static void check_f64(size_t n_rows, size_t n_cols) {
+  unsigned state = 2;
+  double* mat = malloc(n_rows * n_cols * sizeof(double));
+  double* in = malloc(n_cols * sizeof(double));
+  double* out = malloc(n_rows * sizeof(double));
+  double tol = (double)n_cols * DBL_EPSILON;
+  char what[64];
+  size_t k;
+  for (k = 0; k < n_rows * n_cols; ++k) {
+    mat[k] = next_value(&state);
+  }
+  for (k = 0; k < n_cols; ++k) {
+    in[k] = next_value(&state);
+  }
+
+  snprintf(what, sizeof(what), "[f64][%4zu x %zu] matvec_prod", n_rows, n_cols);
+  expect(
+      matvec_prod(MATVEC_F64, n_rows, n_cols, mat, in, out) == MATVEC_OK &&
+          max_rel_err_f64(mat, in, out, n_rows, n_cols) <= tol,
+      what);
+
+  snprintf(
+      what, sizeof(what), "[f64][%4zu x %zu] matvec_prod_f64", n_rows, n_cols);
+  expect(
+      matvec_prod_f64(n_rows, n_cols, mat, in, out) == MATVEC_OK &&
+          max_rel_err_f64(mat, in, out, n_rows, n_cols) <= tol,
+      what);
+
+  snprintf(
+      what,
+      sizeof(what),
+      "[f64][%4zu x %zu] matvec_get_kernel_f64",
+      n_rows,
+      n_cols);
+  if (n_rows <= MATVEC_MAX_TABLE_ROWS) {
+    matvec_kernel_f64 kernel = matvec_get_kernel_f64(n_rows, n_cols);
+    int ok = kernel != NULL;
+    if (ok) {
+      kernel(mat, in, out);
+      ok = max_rel_err_f64(mat, in, out, n_rows, n_cols) <= tol;
+    }
+    expect(ok, what);
+  } else {
+    expect(matvec_get_kernel_f64(n_rows, n_cols) == NULL, what);
+  }
+
+  free(mat);
+  free(in);
+  free(out);
+}
+
+int main(void) {
+  /* Row counts inside the table, at its end, and past it (whole 128 row
+   * blocks followed by a remainder) */
+  size_t const row_counts[] = {1, 37, MATVEC_MAX_TABLE_ROWS, 300};
+  size_t const col_counts[] = {2, 4, 8};
+  float f32_buf[8] = {0};
+  double f64_buf[8] = {0};
+  size_t r;
+  size_t c;
+
+  for (r = 0; r < sizeof(row_counts) / sizeof(row_counts[0]); ++r) {
+    for (c = 0; c < sizeof(col_counts) / sizeof(col_counts[0]); ++c) {
+      check_f32(row_counts[r], col_counts[c]);
+      check_f64(row_counts[r], col_counts[c]);
+    }
+  }
+
+  expect(
+      matvec_prod((matvec_dtype)2, 1, 4, f32_buf, f32_buf, f32_buf) ==
+          MATVEC_INVALID_TYPE,
+      "matvec_prod, unknown type");
+  expect(
+      matvec_prod(MATVEC_F32, 1, 3, f32_buf, f32_buf, f32_buf) ==
+          MATVEC_INVALID_COLS,
+      "matvec_prod, 3 columns");
+  expect(
+      matvec_prod_f32(1, 16, f32_buf, f32_buf, f32_buf) == MATVEC_INVALID_COLS,
+      "matvec_prod_f32, 16 columns");
+  expect(
+      matvec_prod_f64(1, 0, f64_buf, f64_buf, f64_buf) == MATVEC_INVALID_COLS,
+      "matvec_prod_f64, 0 columns");
+
+  expect(
+      matvec_get_kernel_f32(4, 3) == NULL, "matvec_get_kernel_f32, 3 columns");
+  expect(
+      matvec_get_kernel_f64(4, 16) == NULL,
+      "matvec_get_kernel_f64, 16 columns");
+  expect(
+      matvec_get_kernel_f32(MATVEC_MAX_TABLE_ROWS + 1, 4) == NULL,
+      "matvec_get_kernel_f32, past the table");
+  expect(
+      matvec_get_kernel_f64(MATVEC_MAX_TABLE_ROWS + 1, 8) == NULL,
+      "matvec_get_kernel_f64, past the table");
+
+  expect(matvec_abi_version() == 1, "matvec_abi_version");
+
+  if (failures != 0) {
+    printf("%d failure(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,84 @@
+#include <cstdint>
+#include <vector>
+
+#include "bench.hpp"
+#include "chain.hpp"
+
+EXTERN_128_ALL;
+
+template <typename V> INLINE void relu_inplace(V& v) {
+  relu_::apply(v.data(), static_cast<int>(v.size()));
+}
+
+// y = A3 * relu(A2 * relu(A1 * x)), one matvec::prod per layer with the
+// intermediate vectors written to memory in between.
+// Argument: number of input vectors
+template <typename T, int width, int n_out>
+NOINLINE void bm_chain_prod(benchmark::State& state) {
+  auto n_vecs = static_cast<std::size_t>(state.range(0));
+  Mat<T, width, width> a1{};
+  Mat<T, width, width> a2{};
+  Mat<T, n_out, width> a3{};
+  std::vector<Vec<T, width> > in(n_vecs);
+  std::vector<Vec<T, n_out> > out(n_vecs);
+  Vec<T, width> h1{};
+  Vec<T, width> h2{};
+
+  for (const auto& _ : state) {
+    unused(_);
+    benchmark::DoNotOptimize(a1);
+    for (std::size_t v = 0; v < n_vecs; ++v) {
+      matvec::prod(a1, in[v], h1);
+      relu_inplace(h1);
+      matvec::prod(a2, h1, h2);
+      relu_inplace(h2);
+      matvec::prod(a3, h2, out[v]);
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(
+      state.iterations() * static_cast<std::int64_t>(n_vecs));
+}
+
+// Same chain, fused
+template <typename T, int width, int n_out>
+NOINLINE void bm_chain_fused(benchmark::State& state) {
+  using chain = layer_chain<
+      layer<width, width, relu_>,
+      layer<width, width, relu_>,
+      layer<n_out, width> >;
+  auto n_vecs = static_cast<std::size_t>(state.range(0));
+  std::vector<T> a1(width * width);
+  std::vector<T> a2(width * width);
+  std::vector<T> a3(n_out * width);
+  std::vector<T> in(n_vecs * width);
+  std::vector<T> out(n_vecs * n_out);
+  typename chain::template weights_t<T> weights{
+      a1.data(), a2.data(), a3.data()};
+
+  for (const auto& _ : state) {
+    unused(_);
+    benchmark::DoNotOptimize(a1.data());
+    chain::prod_batch(weights, in.data(), out.data(), n_vecs);
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(
+      state.iterations() * static_cast<std::int64_t>(n_vecs));
+}
+
+#define RUN_CHAIN_BENCHMARKS(T, Width, NOut)                                   \
+  BENCHMARK_TEMPLATE(bm_chain_prod, T, Width, NOut)->Arg(1)->Arg(1024);        \
+  BENCHMARK_TEMPLATE(bm_chain_fused, T, Width, NOut)->Arg(1)->Arg(1024)
+
+RUN_CHAIN_BENCHMARKS(FLOAT_TYPE, NCOLS, NCOLS);
+RUN_CHAIN_BENCHMARKS(FLOAT_TYPE, NCOLS, 1);
+RUN_CHAIN_BENCHMARKS(FLOAT_TYPE, NCOLS, 64);
+
+#define CAT0(x, y) x##_##y
+#define CAT(x, y) CAT0(x, y)
+#define STRINGIZE0(x) #x
+#define STRINGIZE(x) STRINGIZE0(x)
+
+int main() {
+  run_bench(STRINGIZE(CAT(FLOAT_TYPE, NCOLS)) "_chain");
+}
@@ -1,12 +1,72 @@
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
 #include "fmt/color.h"
 #include "fmt/format.h"
 #include "fmt/ostream.h"
 
 #include "bench.hpp"
+#include "chain.hpp"
+#include "coalesce.hpp"
+#include "mixed.hpp"
+#include "strided.hpp"
 #include "simd.hpp"
 
 EXTERN_128_ALL;
 
+void fail() {
+  fmt::print(
+      fmt::bg(fmt::color::red) | fmt::fg(fmt::color::white), "{}", "fail");
+  fmt::print("\n");
+}
+void pass() {
+  fmt::print(
+      fmt::bg(fmt::color::cornflower_blue) | fmt::fg(fmt::color::white),
+      "{}",
+      "pass");
+  fmt::print("\n");
+}
+
+// Ends a "Testing ... : " line, exits on failure
+void expect(bool ok, double err) {
+  if (ok) {
+    pass();
+    return;
+  }
+  fail();
+  fmt::print("error: {}\n", err);
+  std::exit(1);
+}
+
+template <typename T> std::vector<T> random_vec(std::size_t size) {
+  std::vector<T> v(size);
+  for (auto& x : v) {
+    x = blaze::rand<T>();
+  }
+  return v;
+}
+
+// Uniform in [-1, 1), so that sums cancel and relu clips
+template <typename T> std::vector<T> random_signed_vec(std::size_t size) {
+  auto v = random_vec<T>(size);
+  for (auto& x : v) {
+    x = 2 * x - 1;
+  }
+  return v;
+}
+
+template <typename T, int n_cols>
+constexpr double dot_tolerance =
+    n_cols * static_cast<double>(std::numeric_limits<T>::epsilon());
+
+// Shared by every shape, reset per case, so that the hundreds of
+// instantiations below do not each map a region of their own
+arena storage;
+
 template <typename T, int n_rows, int n_cols> void check_result() {
   Mat<T, n_rows, n_cols> mat{};
   Vec<T, n_cols> in{};
@@ -26,23 +86,31 @@ template <typename T, int n_rows, int n_cols> void check_result() {
   blaze_::prod(mat, in, out_eigen);
   matvec::prod(mat, in, out);
 
+  // Same product on copies placed in an arena, through the custom-storage
+  // views; the kernel is the same so the result must match exactly
+  storage.reset();
+  auto mat_view = arena_mat<T, n_rows, n_cols>(storage);
+  auto in_view = arena_vec<T, n_cols>(storage);
+  auto out_view = arena_vec<T, n_rows>(storage);
+  std::copy_n(mat.data(), n_rows * n_cols, mat_view.data());
+  std::copy_n(in.data(), n_cols, in_view.data());
+  matvec::prod(mat_view, in_view, out_view);
+  bool view_match =
+      std::equal(out.data(), out.data() + n_rows, out_view.data());
+
   T err1 = blaze::max(blaze::abs(out - out_eigen));
   T err2 = blaze::max(blaze::abs(out - out_blaze));
   T eps = 4 * std::numeric_limits<T>::epsilon();
-  bool err_cond = err1 > eps or err2 > eps;
-
-  auto fail = [] {
-    fmt::print(
-        fmt::bg(fmt::color::red) | fmt::fg(fmt::color::white), "{}", "fail");
-    fmt::print("\n");
-  };
-  auto pass = [] {
-    fmt::print(
-        fmt::bg(fmt::color::cornflower_blue) | fmt::fg(fmt::color::white),
-        "{}",
-        "pass");
-    fmt::print("\n");
-  };
+#ifdef MATVEC_HOOK
+  // Blaze and Eigen are routed to the same kernel, so they must match it
+  // exactly, and the plain loop checks the kernel itself
+  Vec<T, n_rows> out_loop{};
+  loop_::prod(mat, in, out_loop);
+  T err3 = blaze::max(blaze::abs(out - out_loop));
+  bool err_cond = err1 != 0 or err2 != 0 or err3 > eps or not view_match;
+#else
+  bool err_cond = err1 > eps or err2 > eps or not view_match;
+#endif
 
   fmt::print(
       "Testing [f{}][ {:>3}×{:>2} ] matrix : ",
@@ -53,9 +121,11 @@ template <typename T, int n_rows, int n_cols> void check_result() {
     fail();
     fmt::print(
         "matvec vs eigen: {}\n"
-        "matvec vs blaze: {}\n",
+        "matvec vs blaze: {}\n"
+        "arena views match: {}\n",
         err1,
-        err2);
+        err2,
+        view_match);
     fmt::print(
         "matvec : {}\n"
         "blaze  : {}\n",
@@ -67,6 +137,283 @@ template <typename T, int n_rows, int n_cols> void check_result() {
   }
 }
 
+// matvec_simd_n over whole blocks of MaxStaticRows rows and a remainder
+template <typename T, int n_cols> void check_simd_n(std::size_t n_rows) {
+  blaze::setSeed(0);
+  auto mat = random_vec<T>(n_rows * n_cols);
+  auto in = random_vec<T>(n_cols);
+  std::vector<T> out(n_rows);
+  matvec_simd_n(
+      mat.data(), in.data(), out.data(), n_rows, int_constant<n_cols>{});
+
+  fmt::print(
+      "Testing [f{}][ {:>4}×{:>2} ] matvec_simd_n : ",
+      sizeof(T) * CHAR_BIT,
+      n_rows,
+      n_cols);
+  double err =
+      max_rel_err(mat.data(), n_cols, in.data(), out.data(), n_rows, n_cols);
+  expect(err <= dot_tolerance<T, n_cols>, err);
+}
+
+// Both reductions of the widths with a transpose kernel, forced regardless of
+// use_transpose_kernel, so that the variant matvec_simd skips stays correct
+template <typename T, int n_rows, int n_cols> void check_kernels() {
+  blaze::setSeed(0);
+  auto mat = random_vec<T>(n_rows * n_cols);
+  auto in = random_vec<T>(n_cols);
+  std::vector<T> out(n_rows);
+
+  auto check = [&](char const* name, auto kernel) {
+    kernel(mat.data(), in.data(), out.data(), int_constant<n_cols>{});
+    fmt::print(
+        "Testing [f{}][ {:>4}×{:>2} ] {} : ",
+        sizeof(T) * CHAR_BIT,
+        n_rows,
+        n_cols,
+        name);
+    double err = max_rel_err(
+        mat.data(), n_cols, in.data(), out.data(), n_rows, n_cols);
+    expect(err <= dot_tolerance<T, n_cols>, err);
+  };
+  check("matvec_simd_hadd", matvec_simd_hadd<n_rows, T, n_cols>);
+  check("matvec_simd_transpose", matvec_simd_transpose<n_rows, T, n_cols>);
+}
+
+// matvec_multi and coalescing_dispatcher, n_vecs vectors multiplied by the
+// same matrix, each compared with its own reference product
+template <typename T, int n_cols>
+void check_multi(std::size_t n_rows, std::size_t n_vecs) {
+  blaze::setSeed(0);
+  auto mat = random_vec<T>(n_rows * n_cols);
+  std::vector<std::vector<T> > ins;
+  std::vector<std::vector<T> > outs(n_vecs, std::vector<T>(n_rows));
+  std::vector<T const*> in_ptrs;
+  std::vector<T*> out_ptrs;
+  for (std::size_t v = 0; v < n_vecs; ++v) {
+    ins.push_back(random_vec<T>(n_cols));
+    in_ptrs.push_back(ins[v].data());
+    out_ptrs.push_back(outs[v].data());
+  }
+  auto max_err = [&] {
+    double err = 0;
+    for (std::size_t v = 0; v < n_vecs; ++v) {
+      err = std::max(
+          err,
+          max_rel_err(
+              mat.data(),
+              n_cols,
+              ins[v].data(),
+              outs[v].data(),
+              n_rows,
+              n_cols));
+    }
+    return err;
+  };
+
+  matvec_multi(
+      mat.data(),
+      in_ptrs.data(),
+      out_ptrs.data(),
+      static_cast<int>(n_vecs),
+      n_rows,
+      int_constant<n_cols>{});
+  fmt::print(
+      "Testing [f{}][ {:>4}×{:>2} ] matvec_multi × {} : ",
+      sizeof(T) * CHAR_BIT,
+      n_rows,
+      n_cols,
+      n_vecs);
+  double err = max_err();
+  expect(err <= dot_tolerance<T, n_cols>, err);
+
+  for (auto& out : outs) {
+    std::fill(out.begin(), out.end(), T(0));
+  }
+  {
+    coalescing_dispatcher<T, n_cols> dispatcher;
+    auto h = dispatcher.add_matrix(mat.data(), n_rows);
+    std::vector<std::future<void> > done;
+    for (std::size_t v = 0; v < n_vecs; ++v) {
+      done.push_back(dispatcher.submit(h, in_ptrs[v], out_ptrs[v]));
+    }
+    for (auto& f : done) {
+      f.wait();
+    }
+  }
+  fmt::print(
+      "Testing [f{}][ {:>4}×{:>2} ] coalesced × {} : ",
+      sizeof(T) * CHAR_BIT,
+      n_rows,
+      n_cols,
+      n_vecs);
+  err = max_err();
+  expect(err <= dot_tolerance<T, n_cols>, err);
+}
+
+// layer_chain against its layers evaluated one after the other in long
+// double, with weights and inputs in [-1, 1) so that relu clips. Errors are
+// scaled by |A_n|...|A_1| |in|, which bounds what rounding in every layer
+// can add up to
+template <typename T, typename... Layers> void check_chain(char const* name) {
+  using chain = layer_chain<Layers...>;
+  constexpr std::size_t n_layers = sizeof...(Layers);
+  std::size_t const n_outs[] = {std::size_t{Layers::n_out}...};
+  std::size_t const n_ins[] = {std::size_t{Layers::n_in}...};
+  bool const relus[] = {std::is_same_v<typename Layers::epilogue, relu_>...};
+
+  blaze::setSeed(0);
+  std::vector<std::vector<T> > weights;
+  typename chain::template weights_t<T> weight_ptrs{};
+  for (std::size_t l = 0; l < n_layers; ++l) {
+    weights.push_back(random_signed_vec<T>(n_outs[l] * n_ins[l]));
+    weight_ptrs[l] = weights[l].data();
+  }
+  auto in = random_signed_vec<T>(chain::n_in);
+  std::vector<T> out(chain::n_out);
+  chain::prod(weight_ptrs, in.data(), out.data());
+
+  std::vector<long double> ref(in.begin(), in.end());
+  std::vector<long double> scale;
+  for (T x : in) {
+    scale.push_back(std::fabs(static_cast<long double>(x)));
+  }
+  for (std::size_t l = 0; l < n_layers; ++l) {
+    std::vector<long double> next_ref(n_outs[l]);
+    std::vector<long double> next_scale(n_outs[l]);
+    for (std::size_t i = 0; i < n_outs[l]; ++i) {
+      for (std::size_t j = 0; j < n_ins[l]; ++j) {
+        auto a = static_cast<long double>(weights[l][i * n_ins[l] + j]);
+        next_ref[i] += a * ref[j];
+        next_scale[i] += std::fabs(a) * scale[j];
+      }
+      if (relus[l]) {
+        next_ref[i] = std::max(next_ref[i], 0.0L);
+      }
+    }
+    ref = std::move(next_ref);
+    scale = std::move(next_scale);
+  }
+
+  long double err = 0;
+  for (std::size_t i = 0; i < out.size(); ++i) {
+    err = std::max(
+        err, std::fabs(static_cast<long double>(out[i]) - ref[i]) / scale[i]);
+  }
+  fmt::print("Testing [f{}] layer_chain {} : ", sizeof(T) * CHAR_BIT, name);
+  expect(err <= n_layers * dot_tolerance<T, 8>, static_cast<double>(err));
+}
+
+// matvec_mixed with f32 and f64 output. Products of f32 values are exact in
+// f64, so with f64 output only the f64 sums round, and f32 output adds a
+// single rounding of the result
+template <int n_rows, int n_cols> void check_mixed() {
+  blaze::setSeed(0);
+  auto mat = random_signed_vec<f32>(n_rows * n_cols);
+  auto in = random_signed_vec<f32>(n_cols);
+  std::vector<f32> out_32(n_rows);
+  std::vector<f64> out_64(n_rows);
+  matvec_mixed<n_rows>(
+      mat.data(), in.data(), out_32.data(), int_constant<n_cols>{});
+  matvec_mixed<n_rows>(
+      mat.data(), in.data(), out_64.data(), int_constant<n_cols>{});
+
+  double tol_64 = dot_tolerance<f64, n_cols>;
+  double tol_32 =
+      static_cast<double>(std::numeric_limits<f32>::epsilon()) + tol_64;
+
+  fmt::print(
+      "Testing [f32→f32][ {:>3}×{:>2} ] matvec_mixed : ", n_rows, n_cols);
+  double err = max_rel_err(
+      mat.data(), n_cols, in.data(), out_32.data(), n_rows, n_cols);
+  expect(err <= tol_32, err);
+
+  fmt::print(
+      "Testing [f32→f64][ {:>3}×{:>2} ] matvec_mixed : ", n_rows, n_cols);
+  err = max_rel_err(
+      mat.data(), n_cols, in.data(), out_64.data(), n_rows, n_cols);
+  expect(err <= tol_64, err);
+}
+
+// Sub-block of a random parent matrix with rows ld elements apart
+struct sub_block_case {
+  std::size_t ld;
+  std::size_t first_row;
+  std::size_t first_col;
+  std::size_t row_step;
+  std::size_t n_rows;
+  bool aligned; // whether matvec_strided takes its aligned path
+};
+
+// matvec_sub_block, and through it matvec_strided_n and matvec_strided. The
+// parent matrix comes from the arena, so it starts on a 64 byte boundary
+template <typename T, int n_cols> void check_sub_block(sub_block_case c) {
+  std::size_t parent_rows = c.first_row + c.row_step * (c.n_rows - 1) + 1;
+  blaze::setSeed(0);
+  auto values = random_signed_vec<T>(parent_rows * c.ld);
+  auto in = random_signed_vec<T>(n_cols);
+  std::vector<T> out(c.n_rows);
+  storage.reset();
+  T* parent = storage.allocate_n<T>(values.size());
+  std::copy(values.begin(), values.end(), parent);
+
+  T const* first = parent + c.first_row * c.ld + c.first_col;
+  std::size_t row_stride = c.ld * c.row_step;
+  constexpr std::size_t align = RowAlign<T, n_cols>;
+  bool aligned = reinterpret_cast<std::uintptr_t>(first) % align == 0 and
+                 row_stride * sizeof(T) % align == 0;
+
+  matvec_sub_block(
+      parent,
+      c.ld,
+      c.first_row,
+      c.first_col,
+      c.row_step,
+      in.data(),
+      out.data(),
+      c.n_rows,
+      int_constant<n_cols>{});
+
+  fmt::print(
+      "Testing [f{}][ {:>3}×{:>2} ] sub-block ld {:>2}, column {}, "
+      "every {} row(s), {} : ",
+      sizeof(T) * CHAR_BIT,
+      c.n_rows,
+      n_cols,
+      c.ld,
+      c.first_col,
+      c.row_step,
+      aligned ? "aligned" : "unaligned");
+  double err =
+      max_rel_err(first, row_stride, in.data(), out.data(), c.n_rows, n_cols);
+  expect(aligned == c.aligned and err <= dot_tolerance<T, n_cols>, err);
+}
+
+template <typename T, int n_cols> void check_sub_blocks() {
+  constexpr std::size_t w = n_cols;
+  sub_block_case const cases[] = {
+      // column slice starting on a whole row of the block
+      {4 * w, 3, w, 1, 37, true},
+      {4 * w, 3, w, 1, 200, true},
+      // column slice one element in, odd leading dimension
+      {w + 3, 3, 1, 1, 37, false},
+      {w + 3, 3, 1, 1, 200, false},
+      // every other row
+      {w, 1, 0, 2, 37, true},
+      {2 * w, 0, w, 2, 200, true},
+      // every third row of a column slice
+      {w + 1, 2, 1, 3, 37, false},
+      {w + 1, 2, 1, 3, 200, false},
+  };
+  for (auto const& c : cases) {
+    check_sub_block<T, n_cols>(c);
+  }
+}
+
+std::size_t const simd_n_rows[] = {1, 127, 129, 300, 1031};
+// Partial blocks of MultiVecBlock vectors, and more than one block
+std::size_t const multi_n_vecs[] = {1, 3, 5, 6, 9};
+
 int main() {
   for_each<0, 128>([](auto i) { check_result<f32, decltype(i)::value, 2>(); });
   for_each<0, 128>([](auto i) { check_result<f32, decltype(i)::value, 4>(); });
@@ -74,4 +421,47 @@ int main() {
   for_each<0, 128>([](auto i) { check_result<f64, decltype(i)::value, 2>(); });
   for_each<0, 128>([](auto i) { check_result<f64, decltype(i)::value, 4>(); });
   for_each<0, 128>([](auto i) { check_result<f64, decltype(i)::value, 8>(); });
+
+  for (std::size_t n_rows : simd_n_rows) {
+    check_simd_n<f32, 2>(n_rows);
+    check_simd_n<f32, 4>(n_rows);
+    check_simd_n<f32, 8>(n_rows);
+    check_simd_n<f64, 2>(n_rows);
+    check_simd_n<f64, 4>(n_rows);
+    check_simd_n<f64, 8>(n_rows);
+  }
+
+  for_each<1, 33>([](auto i) { check_kernels<f32, decltype(i)::value, 8>(); });
+  for_each<1, 33>([](auto i) { check_kernels<f64, decltype(i)::value, 4>(); });
+
+  for (std::size_t n_rows : {std::size_t{5}, std::size_t{300}}) {
+    for (std::size_t n_vecs : multi_n_vecs) {
+      check_multi<f32, 2>(n_rows, n_vecs);
+      check_multi<f32, 4>(n_rows, n_vecs);
+      check_multi<f32, 8>(n_rows, n_vecs);
+      check_multi<f64, 2>(n_rows, n_vecs);
+      check_multi<f64, 4>(n_rows, n_vecs);
+      check_multi<f64, 8>(n_rows, n_vecs);
+    }
+  }
+
+  for_each<0, 128>([](auto i) { check_mixed<decltype(i)::value, 2>(); });
+  for_each<0, 128>([](auto i) { check_mixed<decltype(i)::value, 4>(); });
+  for_each<0, 128>([](auto i) { check_mixed<decltype(i)::value, 8>(); });
+
+  check_sub_blocks<f32, 2>();
+  check_sub_blocks<f32, 4>();
+  check_sub_blocks<f32, 8>();
+  check_sub_blocks<f64, 2>();
+  check_sub_blocks<f64, 4>();
+  check_sub_blocks<f64, 8>();
+
+  for_each<0, 2>([](auto t) {
+    using T = std::conditional_t<decltype(t)::value == 0, f32, f64>;
+    check_chain<T, layer<8, 8, relu_>, layer<8, 8, relu_>, layer<5, 8> >(
+        "8-8-8-5, relu");
+    check_chain<T, layer<8, 8>, layer<8, 8>, layer<5, 8> >("8-8-8-5");
+    check_chain<T, layer<4, 4, relu_>, layer<37, 4> >("4-4-37, relu");
+    check_chain<T, layer<2, 2>, layer<8, 2>, layer<64, 8> >("2-2-8-64");
+  });
 }
@@ -0,0 +1,134 @@
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "bench.hpp"
+#include "coalesce.hpp"
+
+// Shared matrix, large enough to live outside of L2
+#ifndef COALESCE_ROWS
+#define COALESCE_ROWS (1 << 16)
+#endif
+#ifndef COALESCE_CLIENTS
+#define COALESCE_CLIENTS 8
+#endif
+#ifndef COALESCE_REQUESTS
+#define COALESCE_REQUESTS 2000
+#endif
+
+#define CAT0(x, y) x##_##y
+#define CAT(x, y) CAT0(x, y)
+#define STRINGIZE0(x) #x
+#define STRINGIZE(x) STRINGIZE0(x)
+
+// Open-loop load generator: each client issues COALESCE_REQUESTS requests at
+// exponentially distributed intervals, for a total rate of `rate` requests
+// per second, and records the latency of each one from its scheduled start.
+// Call(in, out) must not return before the result is written
+template <typename T, int n_cols, typename Call>
+void run_load(benchmark::State& state, double rate, Call const& call) {
+  using clock = std::chrono::steady_clock;
+  std::vector<latency_stats> stats(COALESCE_CLIENTS);
+  tsc_overhead();
+  tsc_per_ns();
+
+  for (const auto& _ : state) {
+    unused(_);
+    std::vector<std::thread> clients;
+    for (std::size_t c = 0; c < stats.size(); ++c) {
+      clients.emplace_back([&, c] {
+        std::mt19937 gen(static_cast<unsigned>(c));
+        std::exponential_distribution<double> gap(rate / COALESCE_CLIENTS);
+        std::vector<T> in(n_cols, T(1));
+        std::vector<T> out(COALESCE_ROWS);
+        stats[c].samples.reserve(COALESCE_REQUESTS);
+
+        auto next = clock::now();
+        for (int i = 0; i < COALESCE_REQUESTS; ++i) {
+          next += std::chrono::duration_cast<clock::duration>(
+              std::chrono::duration<double>(gap(gen)));
+          std::this_thread::sleep_until(next);
+          // Backdated to the scheduled start, so that the time spent behind
+          // a slow earlier request is part of the latency
+          std::chrono::duration<double, std::nano> late = clock::now() - next;
+          std::uint64_t t0 =
+              tsc_start() -
+              static_cast<std::uint64_t>(late.count() * tsc_per_ns());
+          call(in.data(), out.data());
+          stats[c].add(t0, tsc_stop());
+        }
+      });
+    }
+    for (auto& t : clients) {
+      t.join();
+    }
+  }
+
+  latency_stats all;
+  for (auto& s : stats) {
+    all.samples.insert(all.samples.end(), s.samples.begin(), s.samples.end());
+  }
+  all.report(state.counters);
+  state.SetItemsProcessed(
+      state.iterations() * COALESCE_CLIENTS * COALESCE_REQUESTS);
+}
+
+template <typename T, int n_cols> std::vector<T> const& shared_matrix() {
+  static std::vector<T> const mat(std::size_t{COALESCE_ROWS} * n_cols, T(1));
+  return mat;
+}
+
+// Every request reads the whole matrix on its own thread
+template <typename T, int n_cols>
+NOINLINE void bm_direct(benchmark::State& state) {
+  auto const& mat = shared_matrix<T, n_cols>();
+  run_load<T, n_cols>(
+      state, static_cast<double>(state.range(0)), [&](T const* in, T* out) {
+        matvec_simd_n(
+            mat.data(), in, out, COALESCE_ROWS, int_constant<n_cols>{});
+      });
+}
+
+// Arguments: arrival rate in requests/s, window in µs, max batch size
+template <typename T, int n_cols>
+NOINLINE void bm_coalesced(benchmark::State& state) {
+  auto const& mat = shared_matrix<T, n_cols>();
+  coalescing_dispatcher<T, n_cols> dispatcher(
+      std::chrono::microseconds(state.range(1)),
+      static_cast<std::size_t>(state.range(2)));
+  auto h = dispatcher.add_matrix(mat.data(), COALESCE_ROWS);
+  run_load<T, n_cols>(
+      state, static_cast<double>(state.range(0)), [&](T const* in, T* out) {
+        dispatcher.submit(h, in, out).wait();
+      });
+}
+
+void coalesce_args(benchmark::internal::Benchmark* b) {
+  for (int rate : {1000, 10000, 50000}) {
+    for (int window : {20, 100}) {
+      for (int max_batch : {4, 16}) {
+        b->Args({rate, window, max_batch});
+      }
+    }
+  }
+}
+
+#define RUN_COALESCE_BENCHMARKS(T, NCols)                                      \
+  BENCHMARK_TEMPLATE(bm_direct, T, NCols)                                      \
+      ->Arg(1000)                                                              \
+      ->Arg(10000)                                                             \
+      ->Arg(50000)                                                             \
+      ->Iterations(1)                                                          \
+      ->UseRealTime()                                                          \
+      ->Unit(benchmark::kMillisecond);                                         \
+  BENCHMARK_TEMPLATE(bm_coalesced, T, NCols)                                   \
+      ->Apply(coalesce_args)                                                   \
+      ->Iterations(1)                                                          \
+      ->UseRealTime()                                                          \
+      ->Unit(benchmark::kMillisecond)
+
+RUN_COALESCE_BENCHMARKS(FLOAT_TYPE, NCOLS);
+
+int main() {
+  run_bench(STRINGIZE(CAT(FLOAT_TYPE, NCOLS)) "_coalesce");
+}
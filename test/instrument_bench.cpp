@@ -0,0 +1,50 @@
+#include "bench.hpp"
+
+// Built twice, with and without MATVEC_INSTRUMENT, and without the extern
+// instantiations so that matvec::prod is compiled in this translation unit.
+// In the disabled build bm_simd_ and bm_kernel must run at the same speed.
+
+template <typename T, int n_rows, int n_cols> struct kernel_ {
+  template <typename M, typename In, typename Out>
+  NOINLINE static void prod(M const& matrix, In const& in, Out& out) {
+    matvec_simd<n_rows>(
+        matrix.data(), in.data(), out.data(), int_constant<n_cols>{});
+  }
+};
+
+// Direct kernel call, no wrapper at all
+template <typename T, int n_rows, int n_cols>
+NOINLINE void bm_kernel(benchmark::State& state) {
+  bm<kernel_<T, n_rows, n_cols>, T, n_rows, n_cols>(state);
+}
+
+#define RUN_INSTRUMENT_BENCHMARKS(T, NCols, NRows)                             \
+  BENCHMARK_TEMPLATE(bm_simd_, T, NRows, NCols);                               \
+  BENCHMARK_TEMPLATE(bm_kernel, T, NRows, NCols)
+
+RUN_INSTRUMENT_BENCHMARKS(FLOAT_TYPE, NCOLS, 1);
+RUN_INSTRUMENT_BENCHMARKS(FLOAT_TYPE, NCOLS, 4);
+RUN_INSTRUMENT_BENCHMARKS(FLOAT_TYPE, NCOLS, 16);
+RUN_INSTRUMENT_BENCHMARKS(FLOAT_TYPE, NCOLS, 64);
+RUN_INSTRUMENT_BENCHMARKS(FLOAT_TYPE, NCOLS, 128);
+
+#ifdef MATVEC_INSTRUMENT
+#define MODE instrument_on
+#else
+#define MODE instrument_off
+#endif
+
+#define CAT0(x, y) x##_##y
+#define CAT(x, y) CAT0(x, y)
+#define STRINGIZE0(x) #x
+#define STRINGIZE(x) STRINGIZE0(x)
+
+int main() {
+  run_bench(STRINGIZE(CAT(CAT(FLOAT_TYPE, NCOLS), MODE)));
+#ifdef MATVEC_INSTRUMENT
+  std::ofstream profile(
+      bench_out_dir() +
+      "/" STRINGIZE(CAT(CAT(FLOAT_TYPE, NCOLS), profile)) ".json");
+  profile_dump(profile);
+#endif
+}
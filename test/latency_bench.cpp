@@ -0,0 +1,27 @@
+#include "bench.hpp"
+
+EXTERN_128_ALL;
+
+RUN_LATENCY_BENCHMARKS(FLOAT_TYPE, NCOLS, 1);
+RUN_LATENCY_BENCHMARKS(FLOAT_TYPE, NCOLS, 2);
+RUN_LATENCY_BENCHMARKS(FLOAT_TYPE, NCOLS, 3);
+RUN_LATENCY_BENCHMARKS(FLOAT_TYPE, NCOLS, 4);
+RUN_LATENCY_BENCHMARKS(FLOAT_TYPE, NCOLS, 6);
+RUN_LATENCY_BENCHMARKS(FLOAT_TYPE, NCOLS, 8);
+RUN_LATENCY_BENCHMARKS(FLOAT_TYPE, NCOLS, 12);
+RUN_LATENCY_BENCHMARKS(FLOAT_TYPE, NCOLS, 16);
+RUN_LATENCY_BENCHMARKS(FLOAT_TYPE, NCOLS, 24);
+RUN_LATENCY_BENCHMARKS(FLOAT_TYPE, NCOLS, 32);
+RUN_LATENCY_BENCHMARKS(FLOAT_TYPE, NCOLS, 48);
+RUN_LATENCY_BENCHMARKS(FLOAT_TYPE, NCOLS, 64);
+RUN_LATENCY_BENCHMARKS(FLOAT_TYPE, NCOLS, 96);
+RUN_LATENCY_BENCHMARKS(FLOAT_TYPE, NCOLS, 128);
+
+#define CAT0(x, y) x##_##y
+#define CAT(x, y) CAT0(x, y)
+#define STRINGIZE0(x) #x
+#define STRINGIZE(x) STRINGIZE0(x)
+
+int main() {
+  run_bench(STRINGIZE(CAT(FLOAT_TYPE, NCOLS)) "_latency");
+}
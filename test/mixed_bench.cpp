@@ -0,0 +1,91 @@
+#include <random>
+#include <vector>
+
+#include "bench.hpp"
+#include "mixed.hpp"
+
+#define CAT0(x, y) x##_##y
+#define CAT(x, y) CAT0(x, y)
+#define STRINGIZE0(x) #x
+#define STRINGIZE(x) STRINGIZE0(x)
+
+// f32 operands and their exact f64 copies
+template <int n_rows, int n_cols> struct mixed_data {
+  std::vector<f32> mat = std::vector<f32>(n_rows * n_cols);
+  std::vector<f32> in = std::vector<f32>(n_cols);
+  std::vector<f64> mat_64;
+  std::vector<f64> in_64;
+
+  mixed_data() {
+    std::mt19937 gen(0);
+    std::uniform_real_distribution<f32> dist(-1, 1);
+    for (auto& x : mat) {
+      x = dist(gen);
+    }
+    for (auto& x : in) {
+      x = dist(gen);
+    }
+    mat_64.assign(mat.begin(), mat.end());
+    in_64.assign(in.begin(), in.end());
+  }
+};
+
+template <typename T, int n_rows, int n_cols, typename Kernel>
+void bm_mixed_run(benchmark::State& state, Kernel const& kernel) {
+  std::vector<T> out(n_rows);
+  kernel(out.data());
+  mixed_data<n_rows, n_cols> d;
+  state.counters["max_rel_err"] = max_rel_err(
+      d.mat.data(), n_cols, d.in.data(), out.data(), n_rows, n_cols);
+
+  for (const auto& _ : state) {
+    unused(_);
+    kernel(out.data());
+    benchmark::ClobberMemory();
+  }
+}
+
+// Pure f32 and pure f64 kernels, the latter on f64 copies of the same data
+template <typename T, int n_rows, int n_cols>
+NOINLINE void bm_pure(benchmark::State& state) {
+  mixed_data<n_rows, n_cols> d;
+  T const* mat;
+  T const* in;
+  if constexpr (std::is_same_v<T, f32>) {
+    mat = d.mat.data();
+    in = d.in.data();
+  } else {
+    mat = d.mat_64.data();
+    in = d.in_64.data();
+  }
+  bm_mixed_run<T, n_rows, n_cols>(state, [&](T* out) {
+    benchmark::DoNotOptimize(mat);
+    matvec_simd<n_rows>(mat, in, out, int_constant<n_cols>{});
+  });
+}
+
+// f32 operands, f64 accumulation, Out result
+template <typename Out, int n_rows, int n_cols>
+NOINLINE void bm_mixed(benchmark::State& state) {
+  mixed_data<n_rows, n_cols> d;
+  f32 const* mat = d.mat.data();
+  f32 const* in = d.in.data();
+  bm_mixed_run<Out, n_rows, n_cols>(state, [&](Out* out) {
+    benchmark::DoNotOptimize(mat);
+    matvec_mixed<n_rows>(mat, in, out, int_constant<n_cols>{});
+  });
+}
+
+#define RUN_MIXED_BENCHMARKS(NCols, NRows)                                     \
+  BENCHMARK_TEMPLATE(bm_pure, f32, (NRows), (NCols));                          \
+  BENCHMARK_TEMPLATE(bm_pure, f64, (NRows), (NCols));                          \
+  BENCHMARK_TEMPLATE(bm_mixed, f32, (NRows), (NCols));                         \
+  BENCHMARK_TEMPLATE(bm_mixed, f64, (NRows), (NCols))
+
+RUN_MIXED_BENCHMARKS(NCOLS, 4);
+RUN_MIXED_BENCHMARKS(NCOLS, 16);
+RUN_MIXED_BENCHMARKS(NCOLS, 32);
+RUN_MIXED_BENCHMARKS(NCOLS, 64);
+RUN_MIXED_BENCHMARKS(NCOLS, 128);
+
+int main() { run_bench(STRINGIZE(CAT(f32, NCOLS)) "_mixed"); }
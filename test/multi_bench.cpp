@@ -120,6 +120,12 @@ RUN_BENCHMARKS(FLOAT_TYPE, NCOLS, 128);
 #define STRINGIZE0(x) #x
 #define STRINGIZE(x) STRINGIZE0(x)
 
+#ifdef MATVEC_HOOK
+#define SUFFIX "_multi_hook"
+#else
+#define SUFFIX "_multi"
+#endif
+
 int main() {
-  run_bench(STRINGIZE(CAT(FLOAT_TYPE, NCOLS)) "_multi");
+  run_bench(STRINGIZE(CAT(FLOAT_TYPE, NCOLS)) SUFFIX);
 }
@@ -0,0 +1,82 @@
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "numa.hpp"
+
+// Size of the matrix, well above the last level cache
+#ifndef NUMA_BYTES
+#define NUMA_BYTES (std::size_t{256} << 20U)
+#endif
+
+#define CAT0(x, y) x##_##y
+#define CAT(x, y) CAT0(x, y)
+#define STRINGIZE0(x) #x
+#define STRINGIZE(x) STRINGIZE0(x)
+
+// One matrix per placement, shared by every benchmark run
+template <typename T, int n_cols, numa_placement placement>
+numa_matvec<T, n_cols>& numa_matrix() {
+  static numa_matvec<T, n_cols> m(NUMA_BYTES / (sizeof(T) * n_cols), placement);
+  return m;
+}
+
+// Whole product with every worker
+template <typename T, int n_cols, numa_placement placement>
+NOINLINE void bm_numa_prod(benchmark::State& state) {
+  auto& m = numa_matrix<T, n_cols, placement>();
+  std::vector<T> in(n_cols, T(1));
+  std::vector<T> out(m.rows());
+  for (const auto& _ : state) {
+    unused(_);
+    m.prod(in.data(), out.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(
+      state.iterations() *
+      static_cast<std::int64_t>(m.rows() * n_cols * sizeof(T)));
+  state.counters["nodes"] = static_cast<double>(m.topology().size());
+  state.counters["threads"] = static_cast<double>(m.threads());
+  state.counters["mbind"] = m.bound() ? 1 : 0;
+}
+
+// Rows of one node, with that node's workers only: the bandwidth each node
+// gets out of its share of the matrix
+template <typename T, int n_cols, numa_placement placement>
+NOINLINE void bm_numa_node(benchmark::State& state) {
+  auto& m = numa_matrix<T, n_cols, placement>();
+  auto k = static_cast<std::size_t>(state.range(0));
+  auto [first, last] = m.node_rows(k);
+  std::vector<T> in(n_cols, T(1));
+  std::vector<T> out(m.rows());
+  for (const auto& _ : state) {
+    unused(_);
+    m.prod_node(k, in.data(), out.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(
+      state.iterations() *
+      static_cast<std::int64_t>((last - first) * n_cols * sizeof(T)));
+  state.counters["node"] = m.topology().nodes[k];
+}
+
+template <typename T, int n_cols, numa_placement placement>
+void register_numa(std::string const& name) {
+  benchmark::RegisterBenchmark(
+      ("bm_numa_prod_" + name).c_str(), bm_numa_prod<T, n_cols, placement>)
+      ->UseRealTime()
+      ->Unit(benchmark::kMillisecond);
+  auto* per_node = benchmark::RegisterBenchmark(
+      ("bm_numa_node_" + name).c_str(), bm_numa_node<T, n_cols, placement>);
+  per_node->UseRealTime()->Unit(benchmark::kMillisecond);
+  // Node indices, see numa_topology
+  for (std::size_t k = 0; k < numa_topology::detect().size(); ++k) {
+    per_node->Arg(static_cast<std::int64_t>(k));
+  }
+}
+
+int main() {
+  register_numa<FLOAT_TYPE, NCOLS, numa_placement::local>("local");
+  register_numa<FLOAT_TYPE, NCOLS, numa_placement::caller>("caller");
+  run_bench(STRINGIZE(CAT(FLOAT_TYPE, NCOLS)) "_numa");
+}
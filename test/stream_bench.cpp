@@ -0,0 +1,109 @@
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "mapped.hpp"
+
+// Size of the on-disk matrix, large enough that readahead reaches steady state
+#ifndef STREAM_BYTES
+#define STREAM_BYTES (std::size_t{1} << 30U)
+#endif
+
+#define CAT0(x, y) x##_##y
+#define CAT(x, y) CAT0(x, y)
+#define STRINGIZE0(x) #x
+#define STRINGIZE(x) STRINGIZE0(x)
+
+template <typename T, int n_cols> std::string const& stream_file() {
+  static std::string const path = [] {
+    std::string p =
+        bench_out_dir() + "/" STRINGIZE(CAT(FLOAT_TYPE, NCOLS)) ".mat";
+
+    std::size_t n_rows = STREAM_BYTES / (sizeof(T) * n_cols);
+    auto m = mapped_matrix<T>::create(p, n_rows, n_cols);
+    for (std::size_t i = 0; i < n_rows * n_cols; ++i) {
+      m.data()[i] = static_cast<T>(i % 7);
+    }
+    m.sync();
+    return p;
+  }();
+  return path;
+}
+
+// Evicts the file from the page cache so every iteration reads from disk
+inline void drop_cache(int fd) {
+  ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+// Raw sequential read() of the whole file, the upper bound for stream_prod
+template <typename T, int n_cols>
+NOINLINE void bm_disk_read(benchmark::State& state) {
+  auto const& path = stream_file<T, n_cols>();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw_errno("open " + path);
+  }
+  ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  std::vector<char> buf(static_cast<std::size_t>(state.range(0)) << 20U);
+  std::size_t total = 0;
+
+  for (const auto& _ : state) {
+    unused(_);
+    state.PauseTiming();
+    drop_cache(fd);
+    state.ResumeTiming();
+
+    total = 0;
+    ::ssize_t n = 0;
+    while ((n = ::pread(
+                fd, buf.data(), buf.size(), static_cast<off_t>(total))) > 0) {
+      total += static_cast<std::size_t>(n);
+      benchmark::DoNotOptimize(buf.data());
+    }
+  }
+  state.SetBytesProcessed(
+      state.iterations() * static_cast<std::int64_t>(total));
+  ::close(fd);
+}
+
+template <typename T, int n_cols>
+NOINLINE void bm_stream(benchmark::State& state) {
+  auto m = mapped_matrix<T>::open(stream_file<T, n_cols>());
+  std::vector<T> in(n_cols, T(1));
+  std::vector<T> out(m.rows());
+  std::size_t chunk_bytes = static_cast<std::size_t>(state.range(0)) << 20U;
+
+  for (const auto& _ : state) {
+    unused(_);
+    state.PauseTiming();
+    drop_cache(m.fd());
+    state.ResumeTiming();
+
+    stream_prod<n_cols>(m, in.data(), out.data(), chunk_bytes);
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(
+      state.iterations() *
+      static_cast<std::int64_t>(m.rows() * m.stride() * sizeof(T)));
+}
+
+// Argument: chunk size in MiB
+#define RUN_STREAM_BENCHMARKS(T, NCols)                                        \
+  BENCHMARK_TEMPLATE(bm_disk_read, T, NCols)                                   \
+      ->Arg(4)                                                                 \
+      ->Arg(64)                                                                \
+      ->UseRealTime()                                                          \
+      ->Unit(benchmark::kMillisecond);                                         \
+  BENCHMARK_TEMPLATE(bm_stream, T, NCols)                                      \
+      ->Arg(4)                                                                 \
+      ->Arg(16)                                                                \
+      ->Arg(64)                                                                \
+      ->Arg(256)                                                               \
+      ->UseRealTime()                                                          \
+      ->Unit(benchmark::kMillisecond)
+
+RUN_STREAM_BENCHMARKS(FLOAT_TYPE, NCOLS);
+
+int main() {
+  run_bench(STRINGIZE(CAT(FLOAT_TYPE, NCOLS)) "_stream");
+}
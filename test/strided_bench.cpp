@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <vector>
+
+#include "bench.hpp"
+#include "strided.hpp"
+
+#define CAT0(x, y) x##_##y
+#define CAT(x, y) CAT0(x, y)
+#define STRINGIZE0(x) #x
+#define STRINGIZE(x) STRINGIZE0(x)
+
+// Sub-block of a [n_rows × row_step][n_cols × width] row-major matrix: its
+// last n_cols columns, every row_step-th row
+template <typename T, int n_cols, std::size_t width, std::size_t row_step>
+struct sub_block {
+  static constexpr std::size_t ld = n_cols * width;
+  static constexpr std::size_t first_col = n_cols * (width - 1);
+
+  std::size_t n_rows;
+  std::vector<T> mat;
+  std::vector<T> in = std::vector<T>(n_cols, T(1));
+  std::vector<T> out;
+
+  explicit sub_block(std::size_t rows)
+      : n_rows{rows}, mat(rows * row_step * ld, T(1)), out(rows) {}
+};
+
+// Argument: number of rows of the sub-block
+void strided_args(benchmark::internal::Benchmark* b) {
+  for (std::int64_t n_rows : {16, 128, 1024, 16384, 262144}) {
+    b->Arg(n_rows);
+  }
+}
+
+// Densely packed matrix of the same size, the lower bound
+template <typename T, int n_cols>
+NOINLINE void bm_dense(benchmark::State& state) {
+  sub_block<T, n_cols, 1, 1> b(static_cast<std::size_t>(state.range(0)));
+  for (const auto& _ : state) {
+    unused(_);
+    benchmark::DoNotOptimize(b.mat.data());
+    matvec_simd_n(
+        b.mat.data(),
+        b.in.data(),
+        b.out.data(),
+        b.n_rows,
+        int_constant<n_cols>{});
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Zero copy, strided kernels
+template <typename T, int n_cols, std::size_t width, std::size_t row_step>
+NOINLINE void bm_sub_view(benchmark::State& state) {
+  using block = sub_block<T, n_cols, width, row_step>;
+  block b(static_cast<std::size_t>(state.range(0)));
+  for (const auto& _ : state) {
+    unused(_);
+    benchmark::DoNotOptimize(b.mat.data());
+    matvec_sub_block(
+        b.mat.data(),
+        block::ld,
+        0,
+        block::first_col,
+        row_step,
+        b.in.data(),
+        b.out.data(),
+        b.n_rows,
+        int_constant<n_cols>{});
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Sub-block copied to a dense buffer first, then the dense kernels
+template <typename T, int n_cols, std::size_t width, std::size_t row_step>
+NOINLINE void bm_sub_copy(benchmark::State& state) {
+  using block = sub_block<T, n_cols, width, row_step>;
+  block b(static_cast<std::size_t>(state.range(0)));
+  std::vector<T> dense(b.n_rows * n_cols);
+  for (const auto& _ : state) {
+    unused(_);
+    benchmark::DoNotOptimize(b.mat.data());
+    T const* src = b.mat.data() + block::first_col;
+    for (std::size_t i = 0; i < b.n_rows; ++i) {
+      std::copy_n(src + i * row_step * block::ld, n_cols, &dense[n_cols * i]);
+    }
+    matvec_simd_n(
+        dense.data(),
+        b.in.data(),
+        b.out.data(),
+        b.n_rows,
+        int_constant<n_cols>{});
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Column slice: last NCOLS columns of a matrix 4 times as wide
+// Interleaved: every other row of a dense matrix
+#define RUN_STRIDED_BENCHMARKS(T, NCols)                                       \
+  BENCHMARK_TEMPLATE(bm_dense, T, NCols)->Apply(strided_args);                 \
+  BENCHMARK_TEMPLATE(bm_sub_view, T, NCols, 4, 1)->Apply(strided_args);        \
+  BENCHMARK_TEMPLATE(bm_sub_copy, T, NCols, 4, 1)->Apply(strided_args);        \
+  BENCHMARK_TEMPLATE(bm_sub_view, T, NCols, 1, 2)->Apply(strided_args);        \
+  BENCHMARK_TEMPLATE(bm_sub_copy, T, NCols, 1, 2)->Apply(strided_args)
+
+RUN_STRIDED_BENCHMARKS(FLOAT_TYPE, NCOLS);
+
+int main() { run_bench(STRINGIZE(CAT(FLOAT_TYPE, NCOLS)) "_strided"); }